@@ -0,0 +1,425 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+#include <new>
+
+#include <Export.hpp>
+#include <FileStorage.hpp>
+#include <OverlapKernel.hpp>
+#include <ShardedRepository.hpp>
+#include <StrategyPipeline.hpp>
+
+#include "datasets.hpp"
+
+using namespace NBooking;
+using namespace NBookingBench;
+
+// Global heap allocations made by the current thread, for the "allocs"
+// counters; a thread_local increment keeps the hook out of the timings.
+static thread_local size_t HeapAllocations = 0;
+
+void* operator new(std::size_t n) {
+    ++HeapAllocations;
+    if (void* p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+    TDatasetSpec SpecFrom(const benchmark::State& state) {
+        TDatasetSpec spec;
+        spec.Rooms = static_cast<size_t>(state.range(0));
+        spec.BookingsPerRoom = static_cast<size_t>(state.range(1));
+        spec.RecurringPercent = static_cast<unsigned>(state.range(2));
+        return spec;
+    }
+
+    struct TFixture {
+        explicit TFixture(const TDatasetSpec& spec, std::shared_ptr<IConflictStrategy> strategy)
+            : Storage(std::make_shared<TMemoryStorage>())
+            , Repo(std::make_shared<TRepository>(Storage))
+            , Mgr(Repo, Storage, std::move(strategy)) {
+            Populate(*Repo, MakeDataset(spec));
+        }
+
+        std::shared_ptr<TMemoryStorage> Storage;
+        std::shared_ptr<TRepository> Repo;
+        TBookingManager Mgr;
+    };
+
+    template <class TStrategyFactory>
+    void RunCreate(benchmark::State& state, TStrategyFactory make) {
+        auto spec = SpecFrom(state);
+        TFixture fx(spec, make());
+        std::mt19937_64 rng(7);
+        auto actor = BenchUser(ERole::Manager);
+        size_t created = 0;
+        size_t allocs = 0;
+        for (auto _ : state) {
+            auto req = RandomRequest(spec, rng);
+            size_t before = HeapAllocations;
+            auto id = fx.Mgr.CreateBooking(req, actor);
+            allocs += HeapAllocations - before;
+            state.PauseTiming();
+            if (id) {
+                ++created;
+                // keep the dataset stable between iterations
+                while (fx.Mgr.Undo(actor)) {
+                }
+            }
+            state.ResumeTiming();
+        }
+        state.counters["accepted"] = benchmark::Counter(static_cast<double>(created), benchmark::Counter::kAvgIterations);
+        state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+    }
+
+    // rooms, bookings per room, recurring percent
+    void CreateArgs(benchmark::internal::Benchmark* b) {
+        b->Args({10, 40, 0})->Args({100, 40, 10})->Args({900, 45, 10})->Args({100, 40, 50});
+    }
+
+    void ListArgs(benchmark::internal::Benchmark* b) {
+        for (int rooms : {10, 100, 900}) {
+            for (int recurring : {0, 10, 50}) {
+                b->Args({rooms, 40, recurring});
+            }
+        }
+    }
+
+} // namespace
+
+static void BM_CreateReject(benchmark::State& state) {
+    RunCreate(state, [] {
+        return std::make_shared<TRejectStrategy>();
+    });
+}
+BENCHMARK(BM_CreateReject)->Apply(CreateArgs);
+
+static void BM_CreateAutoBump(benchmark::State& state) {
+    RunCreate(state, [] {
+        return std::make_shared<TAutoBumpStrategy>();
+    });
+}
+BENCHMARK(BM_CreateAutoBump)->Apply(CreateArgs);
+
+static void BM_CreatePreempt(benchmark::State& state) {
+    RunCreate(state, [] {
+        return std::make_shared<TPreemptStrategy>();
+    });
+}
+BENCHMARK(BM_CreatePreempt)->Apply(CreateArgs);
+
+static void BM_CreateQuorum(benchmark::State& state) {
+    RunCreate(state, [] {
+        return std::make_shared<TQuorumStrategy>(3);
+    });
+}
+BENCHMARK(BM_CreateQuorum)->Apply(CreateArgs);
+
+// "Reject unless quorum, else preempt", fixed at build time versus
+// assembled at runtime and handed to SetStrategy.
+using TQuorumPreemptPipeline = TStrategyPipeline<TRequireQuorumStage, TPreemptStage>;
+
+static void BM_CreateComposedStatic(benchmark::State& state) {
+    RunCreate(state, [] {
+        return std::make_shared<TQuorumPreemptPipeline>(TRequireQuorumStage{3}, TPreemptStage{});
+    });
+}
+BENCHMARK(BM_CreateComposedStatic)->Apply(CreateArgs);
+
+static void BM_CreateComposedChain(benchmark::State& state) {
+    RunCreate(state, [] {
+        auto chain = std::make_shared<TStageChain>();
+        chain->Then(TRequireQuorumStage{3}).Then(TPreemptStage{});
+        return chain;
+    });
+}
+BENCHMARK(BM_CreateComposedChain)->Apply(CreateArgs);
+
+// Resolve alone against a busy room: 0 static pipeline, 1 runtime chain;
+// second arg is the number of requested instances.
+static void BM_ResolveComposed(benchmark::State& state) {
+    using namespace std::chrono;
+    std::vector<TOccurrence> busy;
+    for (int i = 0; i < 512; ++i) {
+        busy.push_back({BASE_TIME + hours(i), BASE_TIME + hours(i) + minutes(30), BookingId(i + 1), 10});
+    }
+    TOccurrenceSet set(busy);
+    std::vector<TOccurrence> inst;
+    for (int64_t i = 0; i < state.range(1); ++i) {
+        inst.push_back({BASE_TIME + hours(24 * i + 9) + minutes(15), BASE_TIME + hours(24 * i + 10), 0, 0});
+    }
+    TBooking req;
+    req.Attendees = {1, 2, 3};
+
+    std::unique_ptr<IConflictStrategy> strategy;
+    if (state.range(0) == 0) {
+        strategy = std::make_unique<TQuorumPreemptPipeline>(TRequireQuorumStage{3}, TPreemptStage{});
+    } else {
+        auto chain = std::make_unique<TStageChain>();
+        chain->Then(TRequireQuorumStage{3}).Then(TPreemptStage{});
+        strategy = std::move(chain);
+    }
+    auto actor = BenchUser(ERole::Admin);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(strategy->ResolveAll(req, inst, set, actor));
+    }
+}
+BENCHMARK(BM_ResolveComposed)->ArgsProduct({{0, 1}, {1, 16}});
+
+// Nightly import shape: the same requests one by one versus one batch.
+static void BM_ImportOneByOne(benchmark::State& state) {
+    TDatasetSpec spec;
+    spec.Rooms = 100;
+    auto actor = BenchUser(ERole::Manager);
+    std::unique_ptr<TFixture> fx;
+    for (auto _ : state) {
+        state.PauseTiming();
+        fx.reset(); // teardown stays out of the timed region
+        fx = std::make_unique<TFixture>(spec, std::make_shared<TRejectStrategy>());
+        std::mt19937_64 rng(11);
+        std::vector<TBooking> reqs;
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            reqs.push_back(RandomRequest(spec, rng));
+        }
+        state.ResumeTiming();
+        for (auto const& b : reqs) {
+            benchmark::DoNotOptimize(fx->Mgr.CreateBooking(b, actor));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ImportOneByOne)->Arg(100)->Arg(1000);
+
+static void BM_ImportBatch(benchmark::State& state) {
+    TDatasetSpec spec;
+    spec.Rooms = 100;
+    auto actor = BenchUser(ERole::Manager);
+    std::unique_ptr<TFixture> fx;
+    for (auto _ : state) {
+        state.PauseTiming();
+        fx.reset(); // teardown stays out of the timed region
+        fx = std::make_unique<TFixture>(spec, std::make_shared<TRejectStrategy>());
+        std::mt19937_64 rng(11);
+        std::vector<TCreateRequest> reqs;
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            reqs.push_back({RandomRequest(spec, rng), actor});
+        }
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(fx->Mgr.CreateBookings(reqs));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ImportBatch)->Arg(100)->Arg(1000);
+
+static void BM_ListBookings(benchmark::State& state) {
+    auto spec = SpecFrom(state);
+    TFixture fx(spec, std::make_shared<TRejectStrategy>());
+    std::mt19937_64 rng(11);
+    std::uniform_int_distribution<size_t> room(1, spec.Rooms);
+    auto now = BASE_TIME + std::chrono::hours(24 * 2);
+    size_t items = 0;
+    for (auto _ : state) {
+        auto res = fx.Mgr.ListBookings(room(rng), now - std::chrono::hours(24), now + std::chrono::hours(24));
+        items += res.size();
+        benchmark::DoNotOptimize(res);
+    }
+    state.counters["items"] = benchmark::Counter(static_cast<double>(items), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ListBookings)->Apply(ListArgs);
+
+// window in days
+static void BM_GenerateInstancesDaily(benchmark::State& state) {
+    TBooking b = MakeDataset({1, 1, 0, 0})[0];
+    b.Recurrence.type = TRecurrence::Type::Daily;
+    auto to = b.Start + std::chrono::hours(24 * state.range(0));
+    for (auto _ : state) {
+        auto inst = GenerateInstances(b, b.Start, to);
+        benchmark::DoNotOptimize(inst);
+    }
+}
+BENCHMARK(BM_GenerateInstancesDaily)->Arg(7)->Arg(90)->Arg(365);
+
+static void BM_GenerateInstancesWeekly(benchmark::State& state) {
+    TBooking b = MakeDataset({1, 1, 0, 0})[0];
+    b.Recurrence.type = TRecurrence::Type::Weekly;
+    auto to = b.Start + std::chrono::hours(24 * state.range(0));
+    for (auto _ : state) {
+        auto inst = GenerateInstances(b, b.Start, to);
+        benchmark::DoNotOptimize(inst);
+    }
+}
+BENCHMARK(BM_GenerateInstancesWeekly)->Arg(90)->Arg(365);
+
+static void BM_OccurrencesDailyFarWindow(benchmark::State& state) {
+    TBooking b = MakeDataset({1, 1, 0, 0})[0];
+    b.Recurrence.type = TRecurrence::Type::Daily;
+    auto from = b.Start + std::chrono::hours(24 * 3000);
+    for (auto _ : state) {
+        size_t n = 0;
+        for (auto occ : Occurrences(b, from, from + std::chrono::hours(48))) {
+            benchmark::DoNotOptimize(occ);
+            ++n;
+        }
+        benchmark::DoNotOptimize(n);
+    }
+}
+BENCHMARK(BM_OccurrencesDailyFarWindow);
+
+// Whole-repository export to a discarding stream; total bookings, then
+// 0 json, 1 binary.
+static void BM_Export(benchmark::State& state) {
+    auto storage = std::make_shared<TMemoryStorage>();
+    TRepository repo(storage);
+    Populate(repo, MakeDataset({static_cast<size_t>(state.range(0) / 40), 40, 10}));
+    std::ofstream sink("/dev/null", std::ios::binary);
+    for (auto _ : state) {
+        if (state.range(1) == 0) {
+            benchmark::DoNotOptimize(ExportJson(repo, sink));
+        } else {
+            benchmark::DoNotOptimize(ExportBinary(repo, sink));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Export)->ArgsProduct({{40000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+// total bookings
+static void BM_CheckpointMemory(benchmark::State& state) {
+    auto storage = std::make_shared<TMemoryStorage>();
+    TRepository repo(storage);
+    Populate(repo, MakeDataset({static_cast<size_t>(state.range(0) / 40), 40, 10}));
+    for (auto _ : state) {
+        repo.Checkpoint();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CheckpointMemory)->Arg(4000)->Arg(40000)->Unit(benchmark::kMillisecond);
+
+static void BM_ReloadMemory(benchmark::State& state) {
+    auto storage = std::make_shared<TMemoryStorage>();
+    {
+        TRepository repo(storage);
+        Populate(repo, MakeDataset({static_cast<size_t>(state.range(0) / 40), 40, 10}));
+        repo.Checkpoint();
+    }
+    for (auto _ : state) {
+        TRepository repo(storage);
+        benchmark::DoNotOptimize(repo);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReloadMemory)->Arg(4000)->Arg(40000)->Unit(benchmark::kMillisecond);
+
+static void BM_ReloadFile(benchmark::State& state) {
+    auto dir = std::filesystem::temp_directory_path() / "booking_bench_reload";
+    std::filesystem::remove_all(dir);
+    {
+        auto storage = std::make_shared<TFileStorage>(dir);
+        TRepository repo(storage);
+        Populate(repo, MakeDataset({static_cast<size_t>(state.range(0) / 40), 40, 10}));
+        repo.Checkpoint();
+    }
+    for (auto _ : state) {
+        auto storage = std::make_shared<TFileStorage>(dir);
+        TRepository repo(storage);
+        benchmark::DoNotOptimize(repo);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::filesystem::remove_all(dir);
+}
+BENCHMARK(BM_ReloadFile)->Arg(4000)->Arg(40000)->Unit(benchmark::kMillisecond);
+
+static void BM_UndoRedoChurn(benchmark::State& state) {
+    TDatasetSpec spec{100, 40, 10};
+    TFixture fx(spec, std::make_shared<TRejectStrategy>());
+    auto actor = BenchUser(ERole::Manager);
+    std::mt19937_64 rng(3);
+    for (int i = 0; i < state.range(0); ++i) {
+        fx.Mgr.CreateBooking(RandomRequest(spec, rng), actor);
+    }
+    for (auto _ : state) {
+        fx.Mgr.Undo(actor);
+        fx.Mgr.Redo(actor);
+    }
+}
+BENCHMARK(BM_UndoRedoChurn)->Arg(10)->Arg(300);
+
+// Room-local creates from several threads, each thread on its own rooms,
+// against a repository split into range(0) shards.
+static void BM_ShardedCreate(benchmark::State& state) {
+    struct TShardedFixture {
+        explicit TShardedFixture(size_t shards) {
+            for (size_t i = 0; i < shards; ++i) {
+                Storages.push_back(std::make_shared<TMemoryStorage>());
+            }
+            Repo = std::make_shared<TShardedRepository>(Storages);
+            Mgr = std::make_unique<TBookingManager>(Repo, Storages[0], std::make_shared<TRejectStrategy>());
+        }
+
+        std::vector<std::shared_ptr<IStorage>> Storages;
+        std::shared_ptr<TShardedRepository> Repo;
+        std::unique_ptr<TBookingManager> Mgr;
+    };
+    static std::unique_ptr<TShardedFixture> fx;
+    if (state.thread_index() == 0) {
+        fx = std::make_unique<TShardedFixture>(static_cast<size_t>(state.range(0)));
+    }
+
+    using namespace std::chrono;
+    auto actor = BenchUser(ERole::Manager, 7 + state.thread_index());
+    RoomId room = 1 + state.thread_index() * 16;
+    int slot = 0;
+    for (auto _ : state) {
+        TBooking b;
+        b.RoomIdInternal = room + slot % 16;
+        b.UserIdInternal = actor.Id;
+        b.Start = BASE_TIME + minutes(30 * (slot / 16));
+        b.End = b.Start + minutes(30);
+        b.Title = "request";
+        benchmark::DoNotOptimize(fx->Mgr->CreateBooking(b, actor));
+        ++slot;
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        fx.reset();
+    }
+}
+BENCHMARK(BM_ShardedCreate)->Arg(1)->Arg(4)->Threads(1)->Threads(4)->UseRealTime();
+
+// Raw overlap kernel over n intervals, one per kernel the CPU supports.
+static void BM_OverlapKernel(benchmark::State& state) {
+    auto kernel = static_cast<NOverlap::EKernel>(state.range(0));
+    if (!NOverlap::Supported(kernel)) {
+        state.SkipWithError("kernel not supported on this CPU");
+        return;
+    }
+    size_t n = static_cast<size_t>(state.range(1));
+    std::mt19937_64 rng(9);
+    std::uniform_int_distribution<int64_t> t(0, 1 << 20);
+    std::vector<int64_t> starts(n);
+    std::vector<int64_t> ends(n);
+    for (size_t i = 0; i < n; ++i) {
+        starts[i] = t(rng);
+        ends[i] = starts[i] + 600;
+    }
+    std::vector<uint32_t> out(n);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(NOverlap::Collect(kernel, starts.data(), ends.data(), n, 5000, 8000, out.data()));
+    }
+    state.SetLabel(NOverlap::Name(kernel));
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+BENCHMARK(BM_OverlapKernel)->ArgsProduct({{0, 1, 2}, {64, 4096}});
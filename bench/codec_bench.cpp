@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+
+#include <Codec.hpp>
+
+using namespace NBooking;
+
+namespace {
+
+    TBooking SampleBooking() {
+        TBooking b;
+        b.Id = 123456;
+        b.RoomIdInternal = 815;
+        b.UserIdInternal = 4242;
+        b.Start = std::chrono::system_clock::time_point(std::chrono::seconds(1760000000));
+        b.End = b.Start + std::chrono::minutes(45);
+        b.Recurrence.type = TRecurrence::Type::Weekly;
+        b.Recurrence.Until = b.Start + std::chrono::hours(24 * 180);
+        b.Title = "Weekly platform sync";
+        b.Description = "Agenda: incidents, release train, capacity planning";
+        b.Attendees = {11, 12, 13, 104, 2051, 30007, 30008, 41000};
+        b.Resources = {TResource{"projector-7"}, TResource{"vc-panel-3"}};
+        b.OwnerPriority = 50;
+        return b;
+    }
+
+} // namespace
+
+static void BM_EncodeJson(benchmark::State& state) {
+    auto b = SampleBooking();
+    size_t bytes = 0;
+    for (auto _ : state) {
+        auto s = BookingToJson(b).dump();
+        bytes = s.size();
+        benchmark::DoNotOptimize(s);
+    }
+    state.counters["record_bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_EncodeJson);
+
+static void BM_EncodeBinary(benchmark::State& state) {
+    auto b = SampleBooking();
+    std::string s;
+    for (auto _ : state) {
+        s.clear();
+        EncodeBooking(b, s);
+        benchmark::DoNotOptimize(s);
+    }
+    state.counters["record_bytes"] = static_cast<double>(s.size());
+}
+BENCHMARK(BM_EncodeBinary);
+
+static void BM_DecodeJson(benchmark::State& state) {
+    auto s = BookingToJson(SampleBooking()).dump();
+    for (auto _ : state) {
+        TBooking b;
+        FromJSON(nlohmann::json::parse(s), b);
+        benchmark::DoNotOptimize(b);
+    }
+}
+BENCHMARK(BM_DecodeJson);
+
+static void BM_DecodeBinary(benchmark::State& state) {
+    std::string s;
+    EncodeBooking(SampleBooking(), s);
+    for (auto _ : state) {
+        TBooking b;
+        DecodeBooking(s, b);
+        benchmark::DoNotOptimize(b);
+    }
+}
+BENCHMARK(BM_DecodeBinary);
+
+static void BM_EncodeJournalJson(benchmark::State& state) {
+    TJournalEntry e{77, EJournalOp::Create, SampleBooking(), 123456};
+    for (auto _ : state) {
+        auto s = JournalEntryToJson(e).dump();
+        benchmark::DoNotOptimize(s);
+    }
+}
+BENCHMARK(BM_EncodeJournalJson);
+
+static void BM_EncodeJournalBinary(benchmark::State& state) {
+    TJournalEntry e{77, EJournalOp::Create, SampleBooking(), 123456};
+    std::string s;
+    for (auto _ : state) {
+        s.clear();
+        EncodeJournalEntry(e, s);
+        benchmark::DoNotOptimize(s);
+    }
+}
+BENCHMARK(BM_EncodeJournalBinary);
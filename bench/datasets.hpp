@@ -0,0 +1,101 @@
+#pragma once
+#include <random>
+#include <string>
+#include <vector>
+
+#include <BookingManager.hpp>
+
+namespace NBookingBench {
+
+    using namespace NBooking;
+
+    // Fixed origin so datasets are identical between runs and releases.
+    inline const std::chrono::system_clock::time_point BASE_TIME =
+        std::chrono::system_clock::time_point(std::chrono::seconds(1767571200)); // 2026-01-05 00:00 UTC
+
+    struct TDatasetSpec {
+        size_t Rooms = 100;
+        size_t BookingsPerRoom = 40;
+        unsigned RecurringPercent = 10; // share of weekly series
+        unsigned ResourcePercent = 20;  // share holding the floor projector
+        size_t RoomsPerFloor = 30;
+        uint64_t Seed = 42;
+    };
+
+    inline TUser BenchUser(ERole role = ERole::Manager, UserId id = 7) {
+        return TUser{id, "bench", role, role == ERole::Admin ? 100 : (role == ERole::Manager ? 50 : 10)};
+    }
+
+    // Working-day slots laid out without overlaps inside a room, so a
+    // strategy sees a realistic mix of conflicts and gaps.
+    inline std::vector<TBooking> MakeDataset(const TDatasetSpec& spec) {
+        using namespace std::chrono;
+        std::mt19937_64 rng(spec.Seed);
+        std::uniform_int_distribution<int> lenMin(2, 4); // x15 min
+        std::uniform_int_distribution<int> gapMin(0, 4); // x15 min
+        std::uniform_int_distribution<unsigned> pct(0, 99);
+        std::uniform_int_distribution<int> attendees(1, 8);
+
+        std::vector<TBooking> out;
+        out.reserve(spec.Rooms * spec.BookingsPerRoom);
+        for (size_t room = 1; room <= spec.Rooms; ++room) {
+            auto day = BASE_TIME;
+            auto cur = day + hours(8);
+            for (size_t i = 0; i < spec.BookingsPerRoom; ++i) {
+                cur += minutes(15 * gapMin(rng));
+                auto len = minutes(15 * lenMin(rng));
+                if (cur + len > day + hours(20)) {
+                    day += hours(24);
+                    cur = day + hours(8);
+                }
+                TBooking b;
+                b.Id = 0;
+                b.RoomIdInternal = room;
+                b.UserIdInternal = 1 + (i % 50);
+                b.Start = cur;
+                b.End = cur + len;
+                b.Title = "bench-" + std::to_string(room) + "-" + std::to_string(i);
+                b.Description = "generated booking";
+                for (int a = attendees(rng); a > 0; --a) {
+                    b.Attendees.push_back(static_cast<UserId>(a));
+                }
+                if (pct(rng) < spec.ResourcePercent) {
+                    b.Resources.push_back(TResource{"projector-floor-" + std::to_string(room / spec.RoomsPerFloor)});
+                }
+                if (pct(rng) < spec.RecurringPercent) {
+                    b.Recurrence.type = TRecurrence::Type::Weekly;
+                    b.Recurrence.Until = BASE_TIME + hours(24 * 180);
+                }
+                b.OwnerPriority = 10;
+                out.push_back(std::move(b));
+                cur += len;
+            }
+        }
+        return out;
+    }
+
+    inline void Populate(IRepository& repo, const std::vector<TBooking>& data) {
+        for (auto const& b : data) {
+            repo.CreateBooking(b);
+        }
+    }
+
+    // Request landing in a random room somewhere inside the populated days.
+    inline TBooking RandomRequest(const TDatasetSpec& spec, std::mt19937_64& rng) {
+        using namespace std::chrono;
+        std::uniform_int_distribution<size_t> room(1, spec.Rooms);
+        std::uniform_int_distribution<int> slot(0, 3 * 48 - 1); // 3 days x 48 quarter-hours from 08:00
+        TBooking b;
+        b.Id = 0;
+        b.RoomIdInternal = room(rng);
+        b.UserIdInternal = 7;
+        int s = slot(rng);
+        b.Start = BASE_TIME + hours(24 * (s / 48)) + hours(8) + minutes(15 * (s % 48));
+        b.End = b.Start + minutes(45);
+        b.Title = "request";
+        b.Description = "bench request";
+        b.Attendees = {1, 2, 3};
+        return b;
+    }
+
+} // namespace NBookingBench
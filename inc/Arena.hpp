@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+namespace NBooking {
+
+    // Per-thread monotonic arena for the temporaries of one request. A
+    // TScope marks the request; when the outermost scope ends the arena is
+    // rewound to its inline buffer. Blocks that overflow the buffer come from
+    // a per-thread pool that keeps them, so a steady stream of requests stops
+    // touching the global heap once the pool has warmed up.
+    //
+    // Containers allocated from Resource() must not outlive the scope.
+    class TRequestArena {
+    public:
+        class TScope {
+        public:
+            TScope()
+                : Arena(Local()) {
+                ++Arena.Depth;
+            }
+
+            ~TScope() {
+                if (--Arena.Depth == 0) {
+                    Arena.Monotonic.release();
+                }
+            }
+
+            TScope(const TScope&) = delete;
+            TScope& operator=(const TScope&) = delete;
+
+        private:
+            TRequestArena& Arena;
+        };
+
+        static std::pmr::memory_resource* Resource() {
+            return &Local().Monotonic;
+        }
+
+    private:
+        static constexpr size_t INLINE_BYTES = 32 << 10;
+
+        TRequestArena()
+            : Pool(std::pmr::pool_options{0, 1 << 20})
+            , Monotonic(Buffer.data(), Buffer.size(), &Pool) {
+        }
+
+        static TRequestArena& Local() {
+            thread_local TRequestArena arena;
+            return arena;
+        }
+
+    private:
+        std::pmr::unsynchronized_pool_resource Pool;
+        alignas(std::max_align_t) std::array<std::byte, INLINE_BYTES> Buffer;
+        std::pmr::monotonic_buffer_resource Monotonic;
+        size_t Depth = 0;
+    };
+
+} // namespace NBooking
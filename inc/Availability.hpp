@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+
+#include "common.hpp"
+#include "Strategy.hpp"
+
+namespace NBooking {
+
+    struct TFreeSlot {
+        RoomId Room = 0;
+        std::chrono::system_clock::time_point Start;
+        std::chrono::system_clock::time_point End;
+    };
+
+    // "Any room for 10 people with a projector for 1h tomorrow".
+    struct TAvailabilityQuery {
+        std::vector<TRoom> Rooms; // candidates, tried in this order
+        std::chrono::system_clock::time_point From;
+        std::chrono::system_clock::time_point To;
+        std::chrono::system_clock::duration Length{0};
+        size_t Attendees = 0;             // rooms with fewer seats are skipped
+        std::vector<TResource> Resources; // must be free for the whole slot
+        size_t Limit = 1;                 // rooms to return
+    };
+
+    // Gaps between the busy occurrences inside [from, to) that are at least
+    // minLength long. One forward pass from the binary-searched lower bound.
+    inline std::vector<TFreeSlot> FreeIntervals(RoomId room,
+                                                const TOccurrenceSet& busy,
+                                                std::chrono::system_clock::time_point from,
+                                                std::chrono::system_clock::time_point to,
+                                                std::chrono::system_clock::duration minLength = {}) {
+        std::vector<TFreeSlot> out;
+        auto emit = [&](std::chrono::system_clock::time_point s, std::chrono::system_clock::time_point e) {
+            if (s < e && e - s >= minLength) {
+                out.push_back({room, s, e});
+            }
+        };
+        auto cursor = from;
+        auto const& items = busy.Items();
+        for (size_t i = busy.LowerBound(from); i < items.size() && items[i].Start < to; ++i) {
+            if (items[i].Start > cursor) {
+                emit(cursor, items[i].Start);
+            }
+            cursor = std::max(cursor, items[i].End);
+        }
+        emit(cursor, to);
+        return out;
+    }
+
+} // namespace NBooking
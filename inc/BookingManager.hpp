@@ -2,54 +2,128 @@
 #include <memory>
 #include <mutex>
 #include <deque>
+#include <functional>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 #include "common.hpp"
+#include "Availability.hpp"
 #include "Storage.hpp"
 #include "Strategy.hpp"
 #include "Command.hpp"
+#include "ListCache.hpp"
+#include "LockStripes.hpp"
 
 namespace NBooking {
 
+    struct TBatchItemResult {
+        std::optional<BookingId> Id; // empty when the item was rejected
+        std::optional<std::string> Message;
+    };
+
+    // Undo history is kept per user; the oldest steps are dropped once a
+    // user's history exceeds either limit.
+    struct THistoryOptions {
+        size_t BytesPerUser = 256 << 10;
+        size_t StepsPerUser = 300;
+    };
+
     class TBookingManager {
     public:
         TBookingManager(std::shared_ptr<IRepository> repo,
                         std::shared_ptr<IStorage> storage,
-                        std::shared_ptr<IConflictStrategy> strategy);
+                        std::shared_ptr<IConflictStrategy> strategy,
+                        THistoryOptions history = {});
 
         std::optional<BookingId> CreateBooking(const TBooking& req, const TUser& actor);
         std::optional<BookingId> CreateBooking(const TCreateRequest& req);
+        // Imports many requests at once: one conflict pass per room against
+        // existing bookings and earlier batch items, one journal append and
+        // a single undo step for the whole batch, recorded in the history
+        // of the first request's actor.
+        std::vector<TBatchItemResult> CreateBookings(std::span<const TCreateRequest> reqs);
         bool CancelBooking(BookingId id, const TUser& actor);
 
+        // Reads take only the repository's shared lock, never the room
+        // stripes, so they are not held up by a create's conflict check.
+        // ListBookings answers from the list cache; it sees the writes made
+        // through this manager, not ones applied to the repository directly.
         std::optional<TBooking> GetBooking(BookingId id);
         std::vector<TBooking> ListBookings(RoomId room,
                                            std::chrono::system_clock::time_point from,
                                            std::chrono::system_clock::time_point to);
+        // Streams the same instances without building the list or touching
+        // the cache; f returns false to stop. Long windows such as report
+        // exports stay at one instance in memory.
+        void VisitBookings(RoomId room,
+                           std::chrono::system_clock::time_point from,
+                           std::chrono::system_clock::time_point to,
+                           const std::function<bool(const TBooking&)>& f);
 
-        std::optional<std::string> Undo();
-        std::optional<std::string> Redo();
+        // Free intervals of the room within [from, to); when resources are
+        // given they must be free as well, in whichever room they are used.
+        std::vector<TFreeSlot> FreeSlots(RoomId room,
+                                         std::chrono::system_clock::time_point from,
+                                         std::chrono::system_clock::time_point to,
+                                         const std::vector<TResource>& resources = {});
+        // Earliest fitting slot in each of the first q.Limit matching rooms.
+        std::vector<TFreeSlot> FindAvailable(const TAvailabilityQuery& q);
+
+        // Moves bookings that ended by horizon to the storage's archive
+        // segments; returns how many were moved. See IRepository::Archive.
+        size_t Archive(std::chrono::system_clock::time_point horizon);
+        // Archived and active instances of the room within [from, to).
+        std::vector<TBooking> ListHistory(RoomId room,
+                                          std::chrono::system_clock::time_point from,
+                                          std::chrono::system_clock::time_point to);
+
+        // Undo/redo the actor's own last step; other users' history is untouched.
+        std::optional<std::string> Undo(const TUser& actor);
+        std::optional<std::string> Redo(const TUser& actor);
 
         // for debug
         void SetStrategy(std::shared_ptr<IConflictStrategy> s);
+        size_t HistoryUsers();
 
     private:
         bool CanCreate(const TUser& actor) const;
         bool CanModify(const TUser& actor, const TBooking& target) const;
         bool CanCancel(const TUser& actor, const TBooking& target) const;
 
-        void PushUndo(std::unique_ptr<ICommand> cmd);
+        struct THistory {
+            std::deque<std::unique_ptr<ICommand>> UndoStack;
+            std::deque<std::unique_ptr<ICommand>> RedoStack;
+            size_t Bytes = 0;
+        };
+
+        // HistoryMutex_, with the wait recorded in the metrics.
+        std::unique_lock<std::mutex> LockHistory();
+        void PushUndo(UserId user, std::unique_ptr<ICommand> cmd);
+        // Both drop the user's entry once its stacks are empty.
+        void TrimLocked(UserId user);
+        void EraseIfEmptyLocked(UserId user);
+        std::shared_ptr<IConflictStrategy> Strategy();
 
     private:
         std::shared_ptr<IRepository> Repo;
         std::shared_ptr<IStorage> Storage;
         std::shared_ptr<IConflictStrategy> Strat;
 
-        std::mutex Mutex_;
+        // Creates and cancels lock the stripes of their room and resources,
+        // so bookings for unrelated rooms proceed in parallel.
+        // On a versioned repository creates hold them shared and check
+        // optimistically; after OPTIMISTIC_ATTEMPTS lost races they take
+        // them exclusively, so no create or cancel can overtake the next.
+        TLockStripes Stripes{LOCK_STRIPES};
+        TListCache Lists;
+        std::mutex StratMutex_;
         std::mutex HistoryMutex_;
 
-        std::deque<std::unique_ptr<ICommand>> UndoStack;
-        std::deque<std::unique_ptr<ICommand>> RedoStack;
-        const size_t UNDO_LIMIT = 300;
+        THistoryOptions HistoryOptions;
+        std::unordered_map<UserId, THistory> Histories;
+        static constexpr size_t LOCK_STRIPES = 64;
+        static constexpr size_t OPTIMISTIC_ATTEMPTS = 4;
     };
 
 } // namespace NBooking
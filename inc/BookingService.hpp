@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BookingManager.hpp"
+
+namespace NBooking {
+
+    // Asynchronous front end of TBookingManager. Requests are queued per
+    // room and every room's queue is drained by one worker at a time, so a
+    // room sees its requests in submission order while different rooms run
+    // in parallel. Ready rooms are spread over per-worker queues, each with
+    // its own lock; an idle worker steals from the back of a busy one and
+    // locks only that one. The room queues live in lock stripes of their own.
+    class TBookingService {
+    public:
+        explicit TBookingService(TBookingManager& mgr, size_t workers = std::thread::hardware_concurrency());
+        ~TBookingService();
+
+        TBookingService(const TBookingService&) = delete;
+        TBookingService& operator=(const TBookingService&) = delete;
+
+        std::future<std::optional<BookingId>> CreateBooking(TBooking req, TUser actor);
+        std::future<bool> CancelBooking(BookingId id, TUser actor);
+        std::future<std::vector<TBooking>> ListBookings(RoomId room,
+                                                        std::chrono::system_clock::time_point from,
+                                                        std::chrono::system_clock::time_point to);
+
+        // Runs everything already queued, then stops the workers.
+        void Shutdown();
+
+    private:
+        using TTask = std::function<void()>;
+
+        struct TRoomQueue {
+            std::deque<TTask> Tasks;
+            bool Scheduled = false; // sitting in a ready queue or being drained
+        };
+
+        template <class R, class F>
+        std::future<R> Submit(RoomId room, F&& f) {
+            auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+            auto fut = task->get_future();
+            Enqueue(room, [task] {
+                (*task)();
+            });
+            return fut;
+        }
+
+        struct TWorkerQueue {
+            std::mutex Mutex_;
+            std::deque<RoomId> Ready;
+        };
+
+        struct TRoomStripe {
+            std::mutex Mutex_;
+            std::unordered_map<RoomId, TRoomQueue> Rooms;
+        };
+
+        TRoomStripe& StripeOf(RoomId room) {
+            return Stripes[std::hash<RoomId>{}(room) % Stripes.size()];
+        }
+
+        void Enqueue(RoomId room, TTask task);
+        void PushReady(size_t worker, RoomId room);
+        bool PopReady(size_t worker, RoomId& room);
+        bool AnyReady();
+        // Sleeps until work may be available; false once the service stopped
+        // and nothing is left to run.
+        bool WaitForWork();
+        void WorkerLoop(size_t worker);
+
+    private:
+        // Tasks a worker runs from one room before letting other rooms in.
+        static constexpr size_t ROOM_BATCH = 16;
+        static constexpr size_t ROOM_STRIPES = 64;
+        static constexpr std::chrono::milliseconds IDLE_WAIT{50};
+
+        TBookingManager& Mgr;
+
+        std::vector<TRoomStripe> Stripes;
+        std::vector<TWorkerQueue> Queues; // one per worker
+
+        // Idle workers sleep on Cv. Submitting counts Enqueue calls past the
+        // Stopping check, so no worker exits while one may still push.
+        std::mutex IdleMutex_;
+        std::condition_variable Cv;
+        std::atomic<size_t> Idle{0};
+        std::atomic<size_t> Submitting{0};
+        std::atomic<bool> Stopping{false};
+        std::mutex ShutdownMutex_;
+        std::vector<std::thread> Workers;
+    };
+
+} // namespace NBooking
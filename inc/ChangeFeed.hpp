@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "Codec.hpp"
+
+namespace NBooking {
+
+    // One committed journal entry as seen by subscribers. Booking is the new
+    // state for create/update and the removed booking for remove; Previous is
+    // the state an update replaced, so a booking leaving a room is reported
+    // to that room too.
+    struct TChangeEvent {
+        uint64_t Seq = 0;
+        EJournalOp Op = EJournalOp::Create;
+        TBooking Booking{};
+        std::optional<TBooking> Previous;
+    };
+
+    using TChangeEventPtr = std::shared_ptr<const TChangeEvent>;
+
+    // Rooms and resources a subscriber follows; an empty filter follows all.
+    struct TChangeFilter {
+        std::vector<RoomId> Rooms{};
+        std::vector<TResource> Resources{};
+
+        bool Matches(const TChangeEvent& e) const;
+    };
+
+    struct TChangeFeedOptions {
+        size_t QueueLimit = 1024; // undelivered events per subscriber
+        size_t Retain = 4096;     // recent events kept for resuming
+    };
+
+    // Push side of the journal: TRepository publishes every entry it commits,
+    // in sequence order, and subscribers drain their own bounded queues.
+    //
+    // Publishing never blocks on a subscriber. One that falls QueueLimit
+    // events behind is cut off: it keeps what it has queued, Overflowed()
+    // turns true and later events are no longer queued for it. The client
+    // then subscribes again from LastSeq(), which works while the events
+    // after it are still retained; older positions are refused and the
+    // client has to re-read the state. After a restart the window holds the
+    // journal entries replayed on top of the last checkpoint.
+    class TChangeFeed {
+    public:
+        class TSubscription {
+        public:
+            TSubscription(TChangeFilter filter, size_t limit, uint64_t lastSeq);
+
+            // Up to max queued events, waiting up to wait for the first one.
+            std::vector<TChangeEventPtr> Poll(size_t max, std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+            // Seq of the last event handed out by Poll.
+            uint64_t LastSeq() const;
+            bool Overflowed() const;
+
+        private:
+            friend class TChangeFeed;
+            void Push(const TChangeEventPtr& e);
+
+        private:
+            const TChangeFilter Filter;
+            const size_t Limit;
+            mutable std::mutex Mutex_;
+            std::condition_variable Cv;
+            std::deque<TChangeEventPtr> Queue;
+            uint64_t Delivered;
+            bool Cut = false;
+        };
+
+        explicit TChangeFeed(TChangeFeedOptions options = {});
+
+        // Events after afterSeq are replayed from the retained window before
+        // live ones; without afterSeq only new events are delivered. Throws
+        // when events after afterSeq are no longer retained.
+        std::shared_ptr<TSubscription> Subscribe(TChangeFilter filter, std::optional<uint64_t> afterSeq = std::nullopt);
+
+        // Called by the repository under its write lock. Subscribers are
+        // indexed by what they follow, so an event costs the subscribers it
+        // may match rather than all of them.
+        void Publish(std::vector<TChangeEvent> events);
+        // Sets the position of a freshly loaded repository: seq is its last
+        // entry and replayed the events of the journal entries after since.
+        // Positions from since on can be resumed from.
+        void Reset(uint64_t seq, uint64_t since, std::vector<TChangeEvent> replayed);
+        uint64_t LastSeq();
+
+    private:
+        using TSubscribers = std::vector<std::weak_ptr<TSubscription>>;
+        using TTargets = std::vector<std::shared_ptr<TSubscription>>;
+
+        // Appends the live subscribers of list to out, dropping expired ones.
+        static void Collect(TSubscribers& list, TTargets& out);
+        void CollectFor(const TBooking& b, TTargets& out);
+        // Drops expired subscribers and lists left empty.
+        void Sweep();
+
+    private:
+        TChangeFeedOptions Options;
+        std::mutex Mutex_;
+        std::deque<TChangeEventPtr> Recent;
+        uint64_t Oldest = 0; // oldest position the window resumes from
+        uint64_t Seq = 0;
+        TSubscribers Unfiltered;
+        std::unordered_map<RoomId, TSubscribers> ByRoom;
+        std::unordered_map<std::string, TSubscribers> ByResource;
+    };
+
+} // namespace NBooking
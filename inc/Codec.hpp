@@ -0,0 +1,329 @@
+#pragma once
+#include "common.hpp"
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace NBooking {
+
+    enum class ECodec : uint8_t {
+        Json = 0,  // debugging and export
+        Binary = 1 // versioned, length-prefixed records
+    };
+
+    enum class EJournalOp : uint8_t {
+        Create = 0,
+        Update = 1,
+        Remove = 2,
+        Archive = 3 // a removal that moved the booking to an archive segment
+    };
+
+    struct TJournalEntry {
+        uint64_t Seq = 0; // 0 for legacy entries written before sequencing
+        EJournalOp Op = EJournalOp::Create;
+        TBooking Booking{}; // create/update
+        BookingId Id = 0;   // remove/archive
+        uint64_t SegmentSeq = 0; // archive: seq of the segments holding the committed copy
+    };
+
+    inline nlohmann::json BookingToJson(const TBooking& b) {
+        nlohmann::json j;
+        ToJSON(j, b);
+        nlohmann::json r;
+        r["type"] = static_cast<int>(b.Recurrence.type);
+        if (b.Recurrence.Until) {
+            r["until"] = std::chrono::duration_cast<std::chrono::seconds>(b.Recurrence.Until->time_since_epoch()).count();
+        }
+        j["recurrence"] = r;
+        j["attendees"] = nlohmann::json::array();
+        for (auto a : b.Attendees) {
+            j["attendees"].push_back(a);
+        }
+        j["resources"] = nlohmann::json::array();
+        for (auto const& res : b.Resources) {
+            j["resources"].push_back(res.Id);
+        }
+        j["owner_priority"] = b.OwnerPriority;
+        return j;
+    }
+
+    inline void FromJSON(const nlohmann::json& j, TBooking& b) {
+        FromJsonInternal(j, b);
+        // One lookup per optional key: find() instead of contains() + at().
+        if (auto r = j.find("recurrence"); r != j.end()) {
+            if (auto t = r->find("type"); t != r->end()) {
+                b.Recurrence.type = static_cast<TRecurrence::Type>(t->get<int>());
+            }
+            if (auto u = r->find("until"); u != r->end()) {
+                b.Recurrence.Until = std::chrono::system_clock::time_point(std::chrono::seconds(u->get<long long>()));
+            }
+        }
+        if (auto a = j.find("attendees"); a != j.end() && a->is_array()) {
+            std::vector<UserId> attendees;
+            attendees.reserve(a->size());
+            for (auto const& x : *a) {
+                attendees.push_back(x.get<UserId>());
+            }
+            b.Attendees = std::move(attendees);
+        }
+        if (auto rs = j.find("resources"); rs != j.end() && rs->is_array()) {
+            std::vector<TResource> resources;
+            resources.reserve(rs->size());
+            for (auto const& r : *rs) {
+                resources.push_back(TResource{r.get<std::string>()});
+            }
+            b.Resources = std::move(resources);
+        }
+        if (auto p = j.find("owner_priority"); p != j.end()) {
+            b.OwnerPriority = p->get<int>();
+        }
+    }
+
+    inline nlohmann::json JournalEntryToJson(const TJournalEntry& e) {
+        nlohmann::json j;
+        switch (e.Op) {
+            case EJournalOp::Create:
+                j = {{"op", "create"}, {"booking", BookingToJson(e.Booking)}};
+                break;
+            case EJournalOp::Update:
+                j = {{"op", "update"}, {"booking", BookingToJson(e.Booking)}};
+                break;
+            case EJournalOp::Remove:
+                j = {{"op", "remove"}, {"id", e.Id}};
+                break;
+            case EJournalOp::Archive:
+                j = {{"op", "archive"}, {"id", e.Id}, {"segment", e.SegmentSeq}};
+                break;
+        }
+        j["seq"] = e.Seq;
+        return j;
+    }
+
+    inline TJournalEntry JournalEntryFromJson(const nlohmann::json& j) {
+        TJournalEntry e;
+        e.Seq = j.contains("seq") ? j["seq"].get<uint64_t>() : 0;
+        auto const& op = j.at("op").get_ref<const std::string&>();
+        if (op == "create" || op == "update") {
+            e.Op = op == "create" ? EJournalOp::Create : EJournalOp::Update;
+            FromJSON(j.at("booking"), e.Booking);
+            e.Id = e.Booking.Id;
+        } else if (op == "remove") {
+            e.Op = EJournalOp::Remove;
+            e.Id = j.at("id").get<BookingId>();
+        } else if (op == "archive") {
+            e.Op = EJournalOp::Archive;
+            e.Id = j.at("id").get<BookingId>();
+            e.SegmentSeq = j.at("segment").get<uint64_t>();
+        } else {
+            throw std::runtime_error("Unknown journal op: " + op);
+        }
+        return e;
+    }
+
+    // Binary layout. Integers are LEB128 varints, signed ones
+    // zigzag-encoded, strings and arrays are prefixed with their length:
+    //   booking: ver id room user start end rec_type [until] title descr
+    //            n_attendees attendees... n_resources (len bytes)... priority
+    //   journal: ver op seq (booking | id | id segment_seq)
+    // rec_type carries the "has until" flag in bit 7. Bookings are version 1;
+    // journal version 2 added the archive op, version 1 entries are still read.
+    namespace NBinary {
+
+        constexpr uint8_t BOOKING_VERSION = 1;
+        constexpr uint8_t JOURNAL_VERSION = 2;
+
+        inline void PutVarint(std::string& out, uint64_t v) {
+            while (v >= 0x80) {
+                out.push_back(static_cast<char>(v | 0x80));
+                v >>= 7;
+            }
+            out.push_back(static_cast<char>(v));
+        }
+
+        inline void PutSigned(std::string& out, int64_t v) {
+            PutVarint(out, (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+        }
+
+        inline void PutString(std::string& out, std::string_view s) {
+            PutVarint(out, s.size());
+            out.append(s.data(), s.size());
+        }
+
+        inline int64_t ToSeconds(std::chrono::system_clock::time_point tp) {
+            return std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+        }
+
+        class TReader {
+        public:
+            explicit TReader(std::string_view data)
+                : Data(data) {
+            }
+
+            uint8_t Byte() {
+                Need(1);
+                return static_cast<uint8_t>(Data[Pos++]);
+            }
+
+            uint64_t Varint() {
+                uint64_t v = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    uint8_t b = Byte();
+                    v |= static_cast<uint64_t>(b & 0x7f) << shift;
+                    if (!(b & 0x80)) {
+                        return v;
+                    }
+                }
+                throw std::runtime_error("Binary codec: varint overflow");
+            }
+
+            int64_t Signed() {
+                uint64_t v = Varint();
+                return static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+            }
+
+            std::string_view String() {
+                uint64_t n = Varint();
+                Need(n);
+                auto s = Data.substr(Pos, n);
+                Pos += n;
+                return s;
+            }
+
+            // Element count; every element takes at least one byte.
+            size_t Count() {
+                uint64_t n = Varint();
+                Need(n);
+                return static_cast<size_t>(n);
+            }
+
+            bool AtEnd() const {
+                return Pos == Data.size();
+            }
+
+        private:
+            void Need(uint64_t n) const {
+                if (Data.size() - Pos < n) {
+                    throw std::runtime_error("Binary codec: truncated record");
+                }
+            }
+
+        private:
+            std::string_view Data;
+            size_t Pos = 0;
+        };
+
+        inline void EncodeBookingBody(std::string& out, const TBooking& b) {
+            PutVarint(out, b.Id);
+            PutVarint(out, b.RoomIdInternal);
+            PutVarint(out, b.UserIdInternal);
+            PutSigned(out, ToSeconds(b.Start));
+            PutSigned(out, ToSeconds(b.End));
+            uint8_t rec = static_cast<uint8_t>(b.Recurrence.type);
+            if (b.Recurrence.Until) {
+                rec |= 0x80;
+            }
+            out.push_back(static_cast<char>(rec));
+            if (b.Recurrence.Until) {
+                PutSigned(out, ToSeconds(*b.Recurrence.Until));
+            }
+            PutString(out, *b.Title);
+            PutString(out, *b.Description);
+            PutVarint(out, b.Attendees.size());
+            for (auto a : b.Attendees) {
+                PutVarint(out, a);
+            }
+            PutVarint(out, b.Resources.size());
+            for (auto const& r : b.Resources) {
+                PutString(out, r.Id);
+            }
+            PutSigned(out, b.OwnerPriority);
+        }
+
+        inline void DecodeBookingBody(TReader& in, TBooking& b) {
+            using std::chrono::seconds;
+            using std::chrono::system_clock;
+            b.Id = in.Varint();
+            b.RoomIdInternal = in.Varint();
+            b.UserIdInternal = in.Varint();
+            b.Start = system_clock::time_point(seconds(in.Signed()));
+            b.End = system_clock::time_point(seconds(in.Signed()));
+            uint8_t rec = in.Byte();
+            if ((rec & 0x7f) > static_cast<uint8_t>(TRecurrence::Type::Weekly)) {
+                throw std::runtime_error("Binary codec: bad recurrence type");
+            }
+            b.Recurrence.type = static_cast<TRecurrence::Type>(rec & 0x7f);
+            b.Recurrence.Until.reset();
+            if (rec & 0x80) {
+                b.Recurrence.Until = system_clock::time_point(seconds(in.Signed()));
+            }
+            b.Title = std::string(in.String());
+            b.Description = std::string(in.String());
+            std::vector<UserId> attendees(in.Count());
+            for (auto& a : attendees) {
+                a = in.Varint();
+            }
+            b.Attendees = std::move(attendees);
+            std::vector<TResource> resources(in.Count());
+            for (auto& r : resources) {
+                r.Id = in.String();
+            }
+            b.Resources = std::move(resources);
+            b.OwnerPriority = static_cast<int>(in.Signed());
+        }
+
+    } // namespace NBinary
+
+    inline void EncodeBooking(const TBooking& b, std::string& out) {
+        out.push_back(static_cast<char>(NBinary::BOOKING_VERSION));
+        NBinary::EncodeBookingBody(out, b);
+    }
+
+    inline void DecodeBooking(std::string_view data, TBooking& b) {
+        NBinary::TReader in(data);
+        if (in.Byte() != NBinary::BOOKING_VERSION) {
+            throw std::runtime_error("Binary codec: unsupported booking version");
+        }
+        NBinary::DecodeBookingBody(in, b);
+    }
+
+    inline void EncodeJournalEntry(const TJournalEntry& e, std::string& out) {
+        out.push_back(static_cast<char>(NBinary::JOURNAL_VERSION));
+        out.push_back(static_cast<char>(e.Op));
+        NBinary::PutVarint(out, e.Seq);
+        if (e.Op == EJournalOp::Remove || e.Op == EJournalOp::Archive) {
+            NBinary::PutVarint(out, e.Id);
+            if (e.Op == EJournalOp::Archive) {
+                NBinary::PutVarint(out, e.SegmentSeq);
+            }
+        } else {
+            NBinary::EncodeBookingBody(out, e.Booking);
+        }
+    }
+
+    inline TJournalEntry DecodeJournalEntry(std::string_view data) {
+        NBinary::TReader in(data);
+        uint8_t version = in.Byte();
+        if (version == 0 || version > NBinary::JOURNAL_VERSION) {
+            throw std::runtime_error("Binary codec: unsupported journal version");
+        }
+        TJournalEntry e;
+        uint8_t op = in.Byte();
+        auto last = version == 1 ? EJournalOp::Remove : EJournalOp::Archive;
+        if (op > static_cast<uint8_t>(last)) {
+            throw std::runtime_error("Binary codec: bad journal op");
+        }
+        e.Op = static_cast<EJournalOp>(op);
+        e.Seq = in.Varint();
+        if (e.Op == EJournalOp::Remove || e.Op == EJournalOp::Archive) {
+            e.Id = in.Varint();
+            if (e.Op == EJournalOp::Archive) {
+                e.SegmentSeq = in.Varint();
+            }
+        } else {
+            NBinary::DecodeBookingBody(in, e.Booking);
+            e.Id = e.Booking.Id;
+        }
+        return e;
+    }
+
+} // namespace NBooking
@@ -1,60 +1,434 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <map>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "common.hpp"
+#include "ChangeFeed.hpp"
+#include "Codec.hpp"
+#include "ListCache.hpp"
+#include "Metrics.hpp"
+#include "RoomIntervals.hpp"
 #include "Storage.hpp"
 
 namespace NBooking {
 
+    // Mutations applied together: removals first, then restores and creates.
+    struct TBookingBatch {
+        std::vector<BookingId> Remove;
+        std::vector<TBooking> Restore; // put back under their own ids
+        std::vector<TBooking> Create;  // get fresh ids
+    };
+
+    // One page of a listing in id order. Next is where the following page
+    // starts and is empty after the last one; a page may come back short
+    // (even empty) before the end.
+    struct TBookingPage {
+        std::vector<TBooking> Items;
+        std::optional<BookingId> Next;
+    };
+
+    // Precondition of an optimistic commit: no booking of the rooms or
+    // holding one of the resources was written since ScopeVersion
+    // returned Version.
+    struct TVersionCheck {
+        std::vector<RoomId> Rooms;
+        std::vector<TResource> Resources;
+        uint64_t Version = 0;
+    };
+
+    struct TArchiveResult {
+        std::vector<BookingId> Ids;
+        std::vector<RoomId> Rooms; // sorted, for cache invalidation
+        std::vector<std::string> Segments;
+    };
+
     struct IRepository {
         virtual ~IRepository() = default;
-        virtual BookingId CreateBooking(const TBooking& b) = 0;
-        virtual void UpdateBooking(const TBooking& b) = 0;
+        // Bookings are taken by value; callers move them in when they are done.
+        virtual BookingId CreateBooking(TBooking b) = 0;
+        virtual void UpdateBooking(TBooking b) = 0;
+        // Puts a previously removed booking back under its original id.
+        virtual void RestoreBooking(TBooking b) = 0;
         virtual void RemoveBooking(BookingId id) = 0;
+        // Applies the whole batch under one lock with one journal append.
+        // Returns the ids given to batch.Create, in order.
+        virtual std::vector<BookingId> ApplyBatch(TBookingBatch batch) = 0;
+
+        // Optimistic concurrency. Versioned repositories stamp every write
+        // with its journal seq and keep, per room and per resource, the seq
+        // of the last write touching it; a conflict check that read
+        // ScopeVersion first can then commit without holding any lock.
+        virtual bool Versioned() const {
+            return false;
+        }
+        // Largest seq among writes to the rooms and resources; seqs only
+        // grow, so any such write changes it.
+        virtual uint64_t ScopeVersion(const std::vector<RoomId>& /*rooms*/, const std::vector<TResource>& /*resources*/) {
+            return 0;
+        }
+        // ApplyBatch when check still holds, otherwise nothing is applied
+        // and nullopt comes back.
+        virtual std::optional<std::vector<BookingId>> TryApplyBatch(TBookingBatch /*batch*/, const TVersionCheck& /*check*/) {
+            throw std::runtime_error("Repository has no scope versions");
+        }
+        // Replaces the booking only while its Version is still version;
+        // false when it changed or is gone.
+        virtual bool UpdateBookingIf(TBooking /*b*/, uint64_t /*version*/) {
+            throw std::runtime_error("Repository has no booking versions");
+        }
         virtual std::optional<TBooking> GetBooking(BookingId id) = 0;
         virtual std::vector<TBooking> ListAll() = 0;
+        // Up to limit bookings with ids >= from, ascending. Bookings created
+        // or removed between pages may or may not show up.
+        virtual TBookingPage ListPage(BookingId from, size_t limit) {
+            TBookingPage page;
+            for (auto& b : ListAll()) {
+                if (b.Id >= from) {
+                    page.Items.push_back(std::move(b));
+                }
+            }
+            std::sort(page.Items.begin(), page.Items.end(), [](const TBooking& a, const TBooking& b) {
+                return a.Id < b.Id;
+            });
+            if (page.Items.size() > limit) {
+                page.Next = page.Items[limit].Id;
+                page.Items.resize(limit);
+            }
+            return page;
+        }
+        // Bookings of the room that may have instances overlapping [from, to).
+        virtual std::vector<TBooking> ListInRange(RoomId room,
+                                                  std::chrono::system_clock::time_point from,
+                                                  std::chrono::system_clock::time_point to) = 0;
+        // Bookings holding any of the resources that may overlap [from, to).
+        virtual std::vector<TBooking> ListByResources(const std::vector<TResource>& resources,
+                                                      std::chrono::system_clock::time_point from,
+                                                      std::chrono::system_clock::time_point to) = 0;
+        // Instances overlapping [from, to) straight from the indexes, without
+        // copying the bookings they belong to.
+        virtual std::vector<TOccurrence> RoomOccurrences(RoomId room,
+                                                         std::chrono::system_clock::time_point from,
+                                                         std::chrono::system_clock::time_point to) = 0;
+        virtual std::vector<TOccurrence> ResourceOccurrences(const std::vector<TResource>& resources,
+                                                             std::chrono::system_clock::time_point from,
+                                                             std::chrono::system_clock::time_point to) = 0;
+        // Moves bookings whose last instance ended by horizon out of the
+        // active set into archive segments of the storage, one per month of
+        // that end. Series without Until never qualify.
+        virtual TArchiveResult Archive(std::chrono::system_clock::time_point /*horizon*/) {
+            return {};
+        }
+        // Archived bookings of the room with an instance in [from, to), by start.
+        virtual std::vector<TBooking> ListArchived(RoomId /*room*/,
+                                                   std::chrono::system_clock::time_point /*from*/,
+                                                   std::chrono::system_clock::time_point /*to*/) {
+            return {};
+        }
+        // Same as RoomOccurrences, appended to a caller-owned container so
+        // request-local buffers can come from an arena.
+        virtual void AppendRoomOccurrences(RoomId room,
+                                           std::chrono::system_clock::time_point from,
+                                           std::chrono::system_clock::time_point to,
+                                           std::pmr::vector<TOccurrence>& out) {
+            auto occ = RoomOccurrences(room, from, to);
+            out.insert(out.end(), occ.begin(), occ.end());
+        }
+    };
+
+    // Monotonic booking id source. Ids are never reused, even after the
+    // highest one is removed. One allocator can be shared by several
+    // repositories that must not hand out the same id.
+    class TIdAllocator {
+    public:
+        BookingId Next() {
+            return NextId.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Id that the next call to Next() would return.
+        BookingId Peek() const {
+            return NextId.load(std::memory_order_relaxed);
+        }
+
+        // Makes sure ids below next are never handed out.
+        void Reserve(BookingId next) {
+            auto cur = NextId.load(std::memory_order_relaxed);
+            while (cur < next && !NextId.compare_exchange_weak(cur, next, std::memory_order_relaxed)) {
+            }
+        }
+
+    private:
+        std::atomic<BookingId> NextId{1};
+    };
+
+    // Maps resource ids to dense integer handles so indexes key on an
+    // integer instead of comparing strings.
+    class TResourceInterner {
+    public:
+        using THandle = uint32_t;
+
+        THandle Intern(const std::string& id) {
+            auto [it, inserted] = Handles.try_emplace(id, static_cast<THandle>(Handles.size()));
+            return it->second;
+        }
+
+        std::optional<THandle> Find(const std::string& id) const {
+            auto it = Handles.find(id);
+            if (it == Handles.end()) {
+                return std::nullopt;
+            }
+            return it->second;
+        }
+
+    private:
+        std::unordered_map<std::string, THandle> Handles;
+    };
+
+    enum class EDurability {
+        Snapshot, // full snapshot on every mutation, journal kept as an audit log
+        Journal   // append only the delta, checkpoint a snapshot by threshold
+    };
+
+    struct TRepositoryOptions {
+        EDurability Durability = EDurability::Journal;
+        size_t CheckpointOps = 1000;
+        size_t CheckpointBytes = 4 << 20;
+        std::shared_ptr<TIdAllocator> Ids{}; // own allocator when empty
+        std::shared_ptr<TChangeFeed> Feed{}; // gets every committed entry; one feed per repository
     };
 
     class TRepository: public IRepository {
     public:
-        explicit TRepository(std::shared_ptr<IStorage> storage)
-            : Storage(std::move(storage)) {
+        explicit TRepository(std::shared_ptr<IStorage> storage, TRepositoryOptions options = {})
+            : Storage(std::move(storage))
+            , Options(std::move(options))
+            , Ids(Options.Ids ? Options.Ids : std::make_shared<TIdAllocator>()) {
             Reload();
         }
 
-        BookingId CreateBooking(const TBooking& b) override {
-            std::lock_guard lk(Mutex_);
-            TBooking nb = b;
-            BookingId maxid = 0;
-            for (auto const& ex : Bookings) {
-                maxid = std::max(maxid, ex.first);
+        BookingId CreateBooking(TBooking b) override {
+            std::unique_lock lk(Mutex_);
+            b.Id = Ids->Next();
+            BookingId id = b.Id;
+            auto committed = Commit(TJournalEntry{0, EJournalOp::Create, std::move(b), id});
+            lk.unlock();
+            Finish(committed);
+            return id;
+        }
+
+        void UpdateBooking(TBooking b) override {
+            std::unique_lock lk(Mutex_);
+            BookingId id = b.Id;
+            auto committed = Commit(TJournalEntry{0, EJournalOp::Update, std::move(b), id});
+            lk.unlock();
+            Finish(committed);
+        }
+
+        bool UpdateBookingIf(TBooking b, uint64_t version) override {
+            std::unique_lock lk(Mutex_);
+            auto it = Bookings.find(b.Id);
+            if (it == Bookings.end() || it->second.Version != version) {
+                return false;
             }
-            nb.Id = maxid + 1;
-            Bookings[nb.Id] = nb;
-            Persist();
-            nlohmann::json je = {{"op", "create"}, {"booking", BookingToJson(nb)}};
-            Storage->AppendJournal(je);
-            return nb.Id;
+            BookingId id = b.Id;
+            auto committed = Commit(TJournalEntry{0, EJournalOp::Update, std::move(b), id});
+            lk.unlock();
+            Finish(committed);
+            return true;
         }
 
-        void UpdateBooking(const TBooking& b) override {
-            std::lock_guard lk(Mutex_);
-            Bookings[b.Id] = b;
-            Persist();
-            nlohmann::json je = {{"op", "update"}, {"booking", BookingToJson(b)}};
-            Storage->AppendJournal(je);
+        void RestoreBooking(TBooking b) override {
+            std::unique_lock lk(Mutex_);
+            BookingId id = b.Id;
+            auto committed = Commit(TJournalEntry{0, EJournalOp::Create, std::move(b), id});
+            lk.unlock();
+            Finish(committed);
         }
 
         void RemoveBooking(BookingId id) override {
-            std::lock_guard lk(Mutex_);
-            Bookings.erase(id);
-            Persist();
-            nlohmann::json je = {{"op", "remove"}, {"id", id}};
-            Storage->AppendJournal(je);
+            std::unique_lock lk(Mutex_);
+            auto committed = Commit(TJournalEntry{0, EJournalOp::Remove, {}, id});
+            lk.unlock();
+            Finish(committed);
+        }
+
+        std::vector<BookingId> ApplyBatch(TBookingBatch batch) override {
+            std::unique_lock lk(Mutex_);
+            return ApplyBatchLocked(std::move(batch), lk);
+        }
+
+        bool Versioned() const override {
+            return true;
+        }
+
+        uint64_t ScopeVersion(const std::vector<RoomId>& rooms, const std::vector<TResource>& resources) override {
+            std::shared_lock lk(Mutex_);
+            return ScopeVersionLocked(rooms, resources);
+        }
+
+        std::optional<std::vector<BookingId>> TryApplyBatch(TBookingBatch batch, const TVersionCheck& check) override {
+            std::unique_lock lk(Mutex_);
+            if (ScopeVersionLocked(check.Rooms, check.Resources) != check.Version) {
+                return std::nullopt;
+            }
+            return ApplyBatchLocked(std::move(batch), lk);
+        }
+
+        // Writes a snapshot of the current state and drops the journal it covers.
+        // The state is encoded under a shared lock, so readers keep going and
+        // writers wait only for the encoding, not for the storage I/O.
+        void Checkpoint() {
+            std::lock_guard ck(CheckpointMutex_);
+            TSnapshot snap;
+            {
+                std::shared_lock lk(Mutex_);
+                snap = BuildSnapshot();
+            }
+            SaveSnapshot(snap);
+            Storage->TruncateJournal(snap.Seq);
+        }
+
+        // The segments are encoded under the shared lock and written with no
+        // lock held; only committing the removals takes the write lock. A
+        // booking updated or cancelled in between is not removed, and its
+        // copy in the segment is never committed, just as after a crash
+        // between writing and committing. Reads only return copies whose
+        // Archive entry names their segment, so an updated booking shows up
+        // again once a later run archives it and a cancelled one never does.
+        TArchiveResult Archive(std::chrono::system_clock::time_point horizon) override {
+            std::lock_guard runs(ArchiveMutex_);
+            struct TItem {
+                BookingId Id = 0;
+                uint64_t Version = 0; // as encoded
+                RoomId Room = 0;
+            };
+            struct TBucket {
+                std::vector<std::string> Records;
+                std::vector<TItem> Items;
+                TArchiveSegment Segment;
+            };
+            std::map<std::string, TBucket> buckets;
+            uint64_t segSeq = 0;
+            {
+                std::shared_lock lk(Mutex_);
+                for (auto const& [id, b] : Bookings) {
+                    auto last = LastEnd(b);
+                    if (!last || *last > horizon) {
+                        continue;
+                    }
+                    auto& bucket = buckets[MonthBucket(*last)];
+                    auto& seg = bucket.Segment;
+                    if (bucket.Items.empty()) {
+                        seg.MinStart = b.Start;
+                        seg.MaxEnd = *last;
+                    }
+                    seg.MinStart = std::min(seg.MinStart, b.Start);
+                    seg.MaxEnd = std::max(seg.MaxEnd, *last);
+                    seg.Rooms.push_back(b.RoomIdInternal);
+                    EncodeBooking(b, bucket.Records.emplace_back());
+                    bucket.Items.push_back({id, b.Version, b.RoomIdInternal});
+                }
+                // Past every earlier segment even when their runs committed nothing.
+                segSeq = std::max(Seq, Archives.empty() ? 0 : Archives.back().Seq) + 1;
+            }
+            TArchiveResult res;
+            if (buckets.empty()) {
+                return res;
+            }
+
+            for (auto& [month, bucket] : buckets) {
+                auto& seg = bucket.Segment;
+                seg.Seq = segSeq;
+                seg.Name = month + "-" + std::to_string(seg.Seq);
+                std::sort(seg.Rooms.begin(), seg.Rooms.end());
+                seg.Rooms.erase(std::unique(seg.Rooms.begin(), seg.Rooms.end()), seg.Rooms.end());
+                Storage->WriteArchive(seg.Name, SegmentMeta(seg, bucket.Items.size()), bucket.Records);
+                res.Segments.push_back(seg.Name);
+            }
+
+            TCommitted committed;
+            {
+                std::unique_lock lk(Mutex_);
+                std::vector<TJournalEntry> entries;
+                for (auto& [month, bucket] : buckets) {
+                    for (auto const& item : bucket.Items) {
+                        auto it = Bookings.find(item.Id);
+                        if (it == Bookings.end() || it->second.Version != item.Version) {
+                            continue;
+                        }
+                        entries.push_back(TJournalEntry{0, EJournalOp::Archive, {}, item.Id, segSeq});
+                        res.Ids.push_back(item.Id);
+                        res.Rooms.push_back(item.Room);
+                    }
+                    Archives.push_back(std::move(bucket.Segment));
+                }
+                committed = CommitBatch(std::move(entries));
+            }
+            std::sort(res.Rooms.begin(), res.Rooms.end());
+            res.Rooms.erase(std::unique(res.Rooms.begin(), res.Rooms.end()), res.Rooms.end());
+            Finish(committed);
+            return res;
+        }
+
+        std::vector<TBooking> ListArchived(RoomId room,
+                                           std::chrono::system_clock::time_point from,
+                                           std::chrono::system_clock::time_point to) override {
+            std::vector<std::pair<std::string, uint64_t>> segments;
+            {
+                std::shared_lock lk(Mutex_);
+                for (auto const& seg : Archives) {
+                    if (seg.MinStart < to && seg.MaxEnd > from && std::binary_search(seg.Rooms.begin(), seg.Rooms.end(), room)) {
+                        segments.emplace_back(seg.Name, seg.Seq);
+                    }
+                }
+            }
+            std::vector<TBooking> out;
+            std::vector<uint64_t> outSeqs;
+            for (auto const& [name, seq] : segments) {
+                auto view = Storage->MapArchive(name);
+                if (!view) {
+                    continue;
+                }
+                for (auto rec : view->Records) {
+                    TBooking b{};
+                    DecodeBooking(rec, b);
+                    if (b.RoomIdInternal == room && !Occurrences(b, from, to).empty()) {
+                        out.push_back(std::move(b));
+                        outSeqs.push_back(seq);
+                    }
+                }
+            }
+            {
+                // Only the committed copy of each booking, and none of one
+                // that is active again.
+                std::shared_lock lk(Mutex_);
+                size_t kept = 0;
+                for (size_t i = 0; i < out.size(); ++i) {
+                    auto it = Archived.find(out[i].Id);
+                    if (it != Archived.end() && it->second == outSeqs[i] && !Bookings.contains(out[i].Id)) {
+                        out[kept++] = std::move(out[i]);
+                    }
+                }
+                out.resize(kept);
+            }
+            std::sort(out.begin(), out.end(), [](const TBooking& a, const TBooking& b) {
+                return a.Start < b.Start;
+            });
+            return out;
         }
 
         std::optional<TBooking> GetBooking(BookingId id) override {
-            std::lock_guard lk(Mutex_);
+            std::shared_lock lk(Mutex_);
             auto it = Bookings.find(id);
             if (it == Bookings.end()) {
                 return std::nullopt;
@@ -63,7 +437,7 @@ namespace NBooking {
         }
 
         std::vector<TBooking> ListAll() override {
-            std::lock_guard lk(Mutex_);
+            std::shared_lock lk(Mutex_);
             std::vector<TBooking> out;
             out.reserve(Bookings.size());
             for (auto const& kv : Bookings) {
@@ -72,79 +446,690 @@ namespace NBooking {
             return out;
         }
 
+        // Ids are dense, so a page probes them in order instead of sorting
+        // the map; the probes per page are capped so long runs of removed
+        // ids cannot hold the shared lock for long.
+        TBookingPage ListPage(BookingId from, size_t limit) override {
+            std::shared_lock lk(Mutex_);
+            TBookingPage page;
+            page.Items.reserve(std::min(limit, Bookings.size()));
+            const BookingId end = Ids->Peek();
+            const size_t maxProbes = std::max<size_t>(limit * 8, 4096);
+            BookingId id = std::max<BookingId>(from, 1);
+            for (size_t probes = 0; id < end && page.Items.size() < limit && probes < maxProbes; ++id, ++probes) {
+                if (auto it = Bookings.find(id); it != Bookings.end()) {
+                    page.Items.push_back(it->second);
+                }
+            }
+            if (id < end) {
+                page.Next = id;
+            }
+            return page;
+        }
+
+        std::vector<TBooking> ListInRange(RoomId room,
+                                          std::chrono::system_clock::time_point from,
+                                          std::chrono::system_clock::time_point to) override {
+            std::shared_lock lk(Mutex_);
+            std::vector<TBooking> out;
+            auto rit = RoomIndex.find(room);
+            if (rit == RoomIndex.end()) {
+                return out;
+            }
+            auto const& idx = rit->second;
+
+            idx.OneOff.ForEachOverlap(from, to, [&](size_t i) {
+                out.push_back(Bookings.at(idx.OneOff.IdAt(i)));
+            });
+
+            for (BookingId id : idx.Recurring) {
+                auto const& b = Bookings.at(id);
+                if (MayOverlap(b, from, to)) {
+                    out.push_back(b);
+                }
+            }
+            return out;
+        }
+
+        std::vector<TBooking> ListByResources(const std::vector<TResource>& resources,
+                                              std::chrono::system_clock::time_point from,
+                                              std::chrono::system_clock::time_point to) override {
+            std::shared_lock lk(Mutex_);
+            std::vector<TBooking> out;
+            std::unordered_set<BookingId> seen;
+            for (auto const& r : resources) {
+                auto h = Resources.Find(r.Id);
+                if (!h) {
+                    continue;
+                }
+                auto it = ByResource.find(*h);
+                if (it == ByResource.end()) {
+                    continue;
+                }
+                for (BookingId id : it->second) {
+                    auto const& b = Bookings.at(id);
+                    if (MayOverlap(b, from, to) && seen.insert(id).second) {
+                        out.push_back(b);
+                    }
+                }
+            }
+            return out;
+        }
+
+        std::vector<TOccurrence> RoomOccurrences(RoomId room,
+                                                 std::chrono::system_clock::time_point from,
+                                                 std::chrono::system_clock::time_point to) override {
+            std::vector<TOccurrence> out;
+            CollectRoom(room, from, to, out);
+            return out;
+        }
+
+        void AppendRoomOccurrences(RoomId room,
+                                   std::chrono::system_clock::time_point from,
+                                   std::chrono::system_clock::time_point to,
+                                   std::pmr::vector<TOccurrence>& out) override {
+            CollectRoom(room, from, to, out);
+        }
+
+        std::vector<TOccurrence> ResourceOccurrences(const std::vector<TResource>& resources,
+                                                     std::chrono::system_clock::time_point from,
+                                                     std::chrono::system_clock::time_point to) override {
+            std::shared_lock lk(Mutex_);
+            std::vector<TOccurrence> out;
+            std::unordered_set<BookingId> seen;
+            for (auto const& r : resources) {
+                auto h = Resources.Find(r.Id);
+                if (!h) {
+                    continue;
+                }
+                auto it = ByResource.find(*h);
+                if (it == ByResource.end()) {
+                    continue;
+                }
+                for (BookingId id : it->second) {
+                    if (!seen.insert(id).second) {
+                        continue;
+                    }
+                    for (auto occ : Occurrences(Bookings.at(id), from, to)) {
+                        out.push_back(occ);
+                    }
+                }
+            }
+            return out;
+        }
+
     private:
+        // One archive file; its span and rooms let reads skip it unopened.
+        struct TArchiveSegment {
+            std::string Name;
+            uint64_t Seq = 0;
+            std::chrono::system_clock::time_point MinStart;
+            std::chrono::system_clock::time_point MaxEnd;
+            std::vector<RoomId> Rooms; // sorted
+        };
+
+        static std::string MonthBucket(std::chrono::system_clock::time_point t) {
+            std::chrono::year_month_day ymd(std::chrono::floor<std::chrono::days>(t));
+            char buf[16];
+            std::snprintf(buf, sizeof(buf), "%04d%02u", static_cast<int>(ymd.year()), static_cast<unsigned>(ymd.month()));
+            return buf;
+        }
+
+        static nlohmann::json SegmentMeta(const TArchiveSegment& seg, size_t count) {
+            return {{"seq", seg.Seq},
+                    {"min_start", NBinary::ToSeconds(seg.MinStart)},
+                    {"max_end", NBinary::ToSeconds(seg.MaxEnd)},
+                    {"rooms", seg.Rooms},
+                    {"count", count}};
+        }
+
+        static TArchiveSegment SegmentFromMeta(std::string name, const nlohmann::json& meta) {
+            using namespace std::chrono;
+            TArchiveSegment seg;
+            seg.Name = std::move(name);
+            seg.Seq = meta.at("seq").get<uint64_t>();
+            seg.MinStart = system_clock::time_point(seconds(meta.at("min_start").get<long long>()));
+            seg.MaxEnd = system_clock::time_point(seconds(meta.at("max_end").get<long long>()));
+            seg.Rooms = meta.at("rooms").get<std::vector<RoomId>>();
+            return seg;
+        }
+
+        // Hot/cold split: a room's one-off time ranges live in contiguous
+        // arrays, the payload stays in Bookings. Series are few and expanded
+        // on demand.
+        struct TRoomIndex {
+            TRoomIntervals OneOff;
+            std::unordered_set<BookingId> Recurring;
+        };
+
+        template <class TOut>
+        void CollectRoom(RoomId room,
+                         std::chrono::system_clock::time_point from,
+                         std::chrono::system_clock::time_point to,
+                         TOut& out) {
+            std::shared_lock lk(Mutex_);
+            auto rit = RoomIndex.find(room);
+            if (rit == RoomIndex.end()) {
+                return;
+            }
+            auto const& idx = rit->second;
+            // One-off instances come straight from the hot arrays.
+            idx.OneOff.ForEachOverlap(from, to, [&](size_t i) {
+                out.push_back(idx.OneOff.At(i));
+            });
+            for (BookingId id : idx.Recurring) {
+                for (auto occ : Occurrences(Bookings.at(id), from, to)) {
+                    out.push_back(occ);
+                }
+            }
+        }
+
+        // Cheap pre-filter: can any instance of b reach into [from, to)?
+        static bool MayOverlap(const TBooking& b,
+                               std::chrono::system_clock::time_point from,
+                               std::chrono::system_clock::time_point to) {
+            if (b.Recurrence.type == TRecurrence::Type::None) {
+                return IntervalsOverlap(b.Start, b.End, from, to);
+            }
+            if (b.Start >= to) {
+                return false;
+            }
+            return !b.Recurrence.Until || (*b.Recurrence.Until > b.Start && *b.Recurrence.Until + (b.End - b.Start) > from);
+        }
+
+        void IndexInsert(const TBooking& b) {
+            for (auto const& r : b.Resources) {
+                ByResource[Resources.Intern(r.Id)].insert(b.Id);
+            }
+            auto& idx = RoomIndex[b.RoomIdInternal];
+            if (b.Recurrence.type != TRecurrence::Type::None) {
+                idx.Recurring.insert(b.Id);
+                return;
+            }
+            idx.OneOff.Insert(b.Id, b.Start, b.End, b.OwnerPriority);
+        }
+
+        void IndexErase(const TBooking& b) {
+            for (auto const& r : b.Resources) {
+                auto h = Resources.Find(r.Id);
+                if (!h) {
+                    continue;
+                }
+                auto it = ByResource.find(*h);
+                if (it != ByResource.end()) {
+                    it->second.erase(b.Id);
+                    if (it->second.empty()) {
+                        ByResource.erase(it);
+                    }
+                }
+            }
+            auto rit = RoomIndex.find(b.RoomIdInternal);
+            if (rit == RoomIndex.end()) {
+                return;
+            }
+            auto& idx = rit->second;
+            if (b.Recurrence.type != TRecurrence::Type::None) {
+                idx.Recurring.erase(b.Id);
+            } else {
+                idx.OneOff.Erase(b.Id, b.Start);
+            }
+            if (idx.OneOff.empty() && idx.Recurring.empty()) {
+                RoomIndex.erase(rit);
+            }
+        }
+
+        std::vector<BookingId> ApplyBatchLocked(TBookingBatch batch, std::unique_lock<std::shared_mutex>& lk) {
+            std::vector<TJournalEntry> entries;
+            entries.reserve(batch.Remove.size() + batch.Restore.size() + batch.Create.size());
+            for (BookingId id : batch.Remove) {
+                entries.push_back(TJournalEntry{0, EJournalOp::Remove, {}, id});
+            }
+            for (auto& b : batch.Restore) {
+                BookingId id = b.Id;
+                entries.push_back(TJournalEntry{0, EJournalOp::Create, std::move(b), id});
+            }
+            std::vector<BookingId> ids;
+            ids.reserve(batch.Create.size());
+            for (auto& b : batch.Create) {
+                ids.push_back(Ids->Next());
+                b.Id = ids.back();
+                entries.push_back(TJournalEntry{0, EJournalOp::Create, std::move(b), ids.back()});
+            }
+            auto committed = CommitBatch(std::move(entries));
+            lk.unlock();
+            Finish(committed);
+            return ids;
+        }
+
+        uint64_t ScopeVersionLocked(const std::vector<RoomId>& rooms, const std::vector<TResource>& resources) const {
+            uint64_t v = 0;
+            for (RoomId room : rooms) {
+                if (auto it = RoomVersions.find(room); it != RoomVersions.end()) {
+                    v = std::max(v, it->second);
+                }
+            }
+            for (auto const& r : resources) {
+                auto h = Resources.Find(r.Id);
+                if (!h) {
+                    continue;
+                }
+                if (auto it = ResourceVersions.find(*h); it != ResourceVersions.end()) {
+                    v = std::max(v, it->second);
+                }
+            }
+            return v;
+        }
+
+        // Marks the room and resources of b as written at version.
+        void Touch(const TBooking& b, uint64_t version) {
+            RoomVersions[b.RoomIdInternal] = version;
+            for (auto const& r : b.Resources) {
+                ResourceVersions[Resources.Intern(r.Id)] = version;
+            }
+        }
+
+        // Applies a journal entry as a write at version. Like ApplyPut and
+        // ApplyRemove, returns the replaced or removed booking when a feed
+        // needs it; e keeps its booking for the event then.
+        std::optional<TBooking> ApplyEntry(TJournalEntry& e, uint64_t version) {
+            if (e.Op == EJournalOp::Archive) {
+                Archived[e.Id] = e.SegmentSeq;
+            }
+            if (e.Op == EJournalOp::Remove || e.Op == EJournalOp::Archive) {
+                return ApplyRemove(e.Id, version);
+            }
+            e.Booking.Version = version;
+            return ApplyPut(Options.Feed ? e.Booking : std::move(e.Booking));
+        }
+
+        // Both return the replaced or removed booking when a feed needs it.
+        // ApplyPut takes the version from b.Version.
+        std::optional<TBooking> ApplyPut(TBooking b) {
+            std::optional<TBooking> previous;
+            auto [it, inserted] = Bookings.try_emplace(b.Id);
+            if (!inserted) {
+                IndexErase(it->second);
+                Touch(it->second, b.Version);
+                if (Options.Feed) {
+                    previous = std::move(it->second);
+                }
+            }
+            it->second = std::move(b);
+            IndexInsert(it->second);
+            Touch(it->second, it->second.Version);
+            Ids->Reserve(it->first + 1);
+            return previous;
+        }
+
+        std::optional<TBooking> ApplyRemove(BookingId id, uint64_t version) {
+            std::optional<TBooking> removed;
+            auto it = Bookings.find(id);
+            if (it != Bookings.end()) {
+                IndexErase(it->second);
+                Touch(it->second, version);
+                if (Options.Feed) {
+                    removed = std::move(it->second);
+                }
+                Bookings.erase(it);
+            }
+            return removed;
+        }
+
+        // Remove events carry the removed booking so subscribers can tell
+        // which room it left; a remove of an unknown id is not published.
+        // Archiving is not a cancellation and is never published, live or
+        // on replay.
+        static std::optional<TChangeEvent> ToEvent(TJournalEntry& e, std::optional<TBooking> previous) {
+            if (e.Op == EJournalOp::Archive) {
+                return std::nullopt;
+            }
+            if (e.Op != EJournalOp::Remove) {
+                return TChangeEvent{e.Seq, e.Op, std::move(e.Booking), std::move(previous)};
+            }
+            if (!previous) {
+                return std::nullopt;
+            }
+            return TChangeEvent{e.Seq, e.Op, std::move(*previous), std::nullopt};
+        }
+
+        // What a commit leaves for after the write lock is released.
+        struct TCommitted {
+            uint64_t Ticket = 0; // storage ticket of the journal append
+            bool CheckpointDue = false;
+        };
+
+        // Waits for the journal append to be durable, then checkpoints when
+        // due. Runs without the write lock, so readers are not held up by
+        // the sync and concurrent writers share it.
+        void Finish(const TCommitted& committed) {
+            Storage->SyncJournal(committed.Ticket);
+            if (committed.CheckpointDue) {
+                Checkpoint();
+            }
+        }
+
+        TCommitted Commit(TJournalEntry entry) {
+            return CommitEntries(std::span(&entry, 1));
+        }
+
+        TCommitted CommitBatch(std::vector<TJournalEntry> entries) {
+            return CommitEntries(entries);
+        }
+
+        // Journals the entries, then applies them in order, each stamped with
+        // its seq. A failed append throws before Seq or the state change, so
+        // memory never holds a write the journal does not.
+        TCommitted CommitEntries(std::span<TJournalEntry> entries) {
+            if (entries.empty()) {
+                return {};
+            }
+            for (size_t i = 0; i < entries.size(); ++i) {
+                entries[i].Seq = Seq + i + 1;
+            }
+            auto written = AppendJournal(entries);
+            Seq += entries.size();
+            std::vector<TChangeEvent> events;
+            for (auto& e : entries) {
+                auto previous = ApplyEntry(e, e.Seq);
+                if (Options.Feed) {
+                    if (auto ev = ToEvent(e, std::move(previous))) {
+                        events.push_back(std::move(*ev));
+                    }
+                }
+            }
+            if (Options.Feed) {
+                Options.Feed->Publish(std::move(events));
+            }
+
+            TCommitted committed{written.Ticket};
+            JournalBytes += written.Bytes;
+            if (Options.Durability == EDurability::Snapshot) {
+                SaveSnapshot(BuildSnapshot());
+                return committed;
+            }
+            JournalOps += entries.size();
+            if (JournalOps >= Options.CheckpointOps || JournalBytes >= Options.CheckpointBytes) {
+                JournalOps = 0;
+                JournalBytes = 0;
+                committed.CheckpointDue = true;
+            }
+            return committed;
+        }
+
+        // Returns what the storage wrote: the bytes drive CheckpointBytes,
+        // the ticket is waited on in Finish.
+        TJournalWrite AppendJournal(std::span<const TJournalEntry> entries) {
+            NMetrics::TScope timer(NMetrics::ETimer::Journal);
+            if (entries.size() == 1) {
+                auto const& entry = entries.front();
+                if (Storage->RecordCodec() == ECodec::Binary) {
+                    std::string rec;
+                    EncodeJournalEntry(entry, rec);
+                    return Storage->AppendJournalRecord(entry.Seq, rec);
+                }
+                return Storage->AppendJournal(JournalEntryToJson(entry));
+            }
+            if (Storage->RecordCodec() == ECodec::Binary) {
+                std::vector<std::pair<uint64_t, std::string>> recs;
+                recs.reserve(entries.size());
+                for (auto const& e : entries) {
+                    EncodeJournalEntry(e, recs.emplace_back(e.Seq, std::string()).second);
+                }
+                return Storage->AppendJournalRecords(recs);
+            }
+            std::vector<nlohmann::json> js;
+            js.reserve(entries.size());
+            for (auto const& e : entries) {
+                js.push_back(JournalEntryToJson(e));
+            }
+            return Storage->AppendJournalBatch(js);
+        }
+
+        // Snapshot first, then every journal entry newer than the snapshot.
+        // Snapshot records are decoded on several threads and indexed in
+        // bulk; the journal tail is replayed one entry at a time and, with a
+        // feed, becomes its retained window so cursors survive the restart.
         void Reload() {
-            std::lock_guard lk(Mutex_);
+            std::unique_lock lk(Mutex_);
             Bookings.clear();
-            nlohmann::json snap = Storage->LoadState();
-            if (snap.is_object() && snap.contains("bookings") && snap["bookings"].is_array()) {
-                for (auto const& jb : snap["bookings"]) {
-                    TBooking b;
-                    FromJSON(jb, b);
-                    Bookings[b.Id] = b;
+            RoomIndex.clear();
+            ByResource.clear();
+            RoomVersions.clear();
+            ResourceVersions.clear();
+            Archived.clear();
+            Seq = 0;
+            std::vector<TBooking> loaded;
+            if (auto view = Storage->MapState()) {
+                loaded.resize(view->Records.size());
+                ParallelFor(loaded.size(), [&](size_t i) {
+                    if (view->Codec == ECodec::Binary) {
+                        DecodeBooking(view->Records[i], loaded[i]);
+                    } else {
+                        FromJSON(nlohmann::json::parse(view->Records[i]), loaded[i]);
+                    }
+                });
+                if (view->Meta.contains("seq")) {
+                    Seq = view->Meta["seq"].get<uint64_t>();
+                }
+                if (view->Meta.contains("next_id")) {
+                    Ids->Reserve(view->Meta["next_id"].get<BookingId>());
+                }
+                if (view->Meta.contains("archived")) {
+                    LoadArchived(view->Meta["archived"]);
+                }
+            } else {
+                nlohmann::json snap = Storage->LoadState();
+                if (snap.is_object() && snap.contains("bookings") && snap["bookings"].is_array()) {
+                    auto const& arr = snap["bookings"];
+                    loaded.resize(arr.size());
+                    ParallelFor(loaded.size(), [&](size_t i) {
+                        FromJSON(arr[i], loaded[i]);
+                    });
+                }
+                if (snap.is_object() && snap.contains("seq")) {
+                    Seq = snap["seq"].get<uint64_t>();
+                }
+                if (snap.is_object() && snap.contains("next_id")) {
+                    Ids->Reserve(snap["next_id"].get<BookingId>());
+                }
+                if (snap.is_object() && snap.contains("archived")) {
+                    LoadArchived(snap["archived"]);
                 }
             }
-        }
+            BulkLoad(std::move(loaded));
 
-        void Persist() {
-            nlohmann::json snap = nlohmann::json::object();
-            snap["bookings"] = nlohmann::json::array();
-            for (auto const& kv : Bookings) {
-                snap["bookings"].push_back(BookingToJson(kv.second));
+            Archives.clear();
+            for (auto& [name, meta] : Storage->ListArchives()) {
+                Archives.push_back(SegmentFromMeta(std::move(name), meta));
+            }
+            std::sort(Archives.begin(), Archives.end(), [](const TArchiveSegment& a, const TArchiveSegment& b) {
+                return a.Seq < b.Seq;
+            });
+
+            const uint64_t snapSeq = Seq;
+            std::vector<TChangeEvent> replayed;
+            auto replay = [&](TJournalEntry e) {
+                if (e.Seq != 0 && e.Seq <= snapSeq) {
+                    return;
+                }
+                Seq = std::max(Seq, e.Seq);
+                auto previous = ApplyEntry(e, Seq);
+                ++JournalOps;
+                if (Options.Feed && e.Seq != 0) {
+                    if (auto ev = ToEvent(e, std::move(previous))) {
+                        replayed.push_back(std::move(*ev));
+                    }
+                }
+            };
+            if (Storage->RecordCodec() == ECodec::Binary) {
+                for (auto const& rec : Storage->LoadJournalRecords()) {
+                    replay(DecodeJournalEntry(rec));
+                }
+            } else {
+                for (auto const& je : Storage->LoadJournal()) {
+                    replay(JournalEntryFromJson(je));
+                }
+            }
+            if (Options.Feed) {
+                Options.Feed->Reset(Seq, snapSeq, std::move(replayed));
             }
-            Storage->SaveState(snap);
         }
 
-        static nlohmann::json BookingToJson(const TBooking& b) {
-            nlohmann::json j;
-            ToJSON(j, b);
-            nlohmann::json r;
-            r["type"] = static_cast<int>(b.Recurrence.type);
-            if (b.Recurrence.Until) {
-                r["until"] = std::chrono::duration_cast<std::chrono::seconds>(b.Recurrence.Until->time_since_epoch()).count();
+        // Fills the empty maps and indexes from a snapshot. Each room's
+        // one-off intervals are sorted once instead of inserted one by one.
+        // Versions are not stored, snapshot bookings take the snapshot seq:
+        // never older than the write that produced them, so a version held
+        // from before the restart can fail a check but never pass a stale one.
+        void BulkLoad(std::vector<TBooking> loaded) {
+            Bookings.reserve(loaded.size());
+            BookingId maxId = 0;
+            for (auto& b : loaded) {
+                maxId = std::max(maxId, b.Id);
+                b.Version = Seq;
+                BookingId id = b.Id;
+                Bookings.insert_or_assign(id, std::move(b));
             }
-            j["recurrence"] = r;
-            j["attendees"] = nlohmann::json::array();
-            for (auto a : b.Attendees) {
-                j["attendees"].push_back(a);
+            Ids->Reserve(maxId + 1);
+
+            std::unordered_map<RoomId, std::vector<TOccurrence>> oneOff;
+            for (auto const& [id, b] : Bookings) {
+                for (auto const& r : b.Resources) {
+                    ByResource[Resources.Intern(r.Id)].insert(id);
+                }
+                if (b.Recurrence.type != TRecurrence::Type::None) {
+                    RoomIndex[b.RoomIdInternal].Recurring.insert(id);
+                } else {
+                    oneOff[b.RoomIdInternal].push_back({b.Start, b.End, id, b.OwnerPriority});
+                }
             }
-            j["resources"] = nlohmann::json::array();
-            for (auto const& res : b.Resources) {
-                j["resources"].push_back(res.Id);
+            for (auto& [room, items] : oneOff) {
+                RoomIndex[room].OneOff.Assign(std::move(items));
             }
-            return j;
         }
 
-        static void FromJSON(const nlohmann::json& j, TBooking& b) {
-            NBooking::FromJsonInternal(j, b);
-            if (j.contains("recurrence")) {
-                auto const& r = j["recurrence"];
-                if (r.contains("type")) {
-                    b.Recurrence.type = static_cast<TRecurrence::Type>(r["type"].get<int>());
+        // Runs f(i) for i in [0, n) on up to hardware_concurrency threads,
+        // in contiguous chunks; small inputs stay on the calling thread.
+        // The first exception thrown by any chunk is rethrown.
+        template <class F>
+        static void ParallelFor(size_t n, F&& f) {
+            constexpr size_t MIN_CHUNK = 2048;
+            size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n / MIN_CHUNK);
+            if (threads <= 1) {
+                for (size_t i = 0; i < n; ++i) {
+                    f(i);
                 }
-                if (r.contains("until")) {
-                    long long s = r["until"].get<long long>();
-                    b.Recurrence.Until = std::chrono::system_clock::time_point(std::chrono::seconds(s));
+                return;
+            }
+            std::vector<std::exception_ptr> errors(threads);
+            std::vector<std::thread> pool;
+            pool.reserve(threads - 1);
+            auto run = [&](size_t t) {
+                try {
+                    for (size_t i = n * t / threads, last = n * (t + 1) / threads; i < last; ++i) {
+                        f(i);
+                    }
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            };
+            for (size_t t = 1; t < threads; ++t) {
+                pool.emplace_back(run, t);
+            }
+            run(0);
+            for (auto& th : pool) {
+                th.join();
+            }
+            for (auto& e : errors) {
+                if (e) {
+                    std::rethrow_exception(e);
                 }
             }
-            if (j.contains("attendees") && j["attendees"].is_array()) {
-                b.Attendees.clear();
-                for (auto const& a : j["attendees"]) {
-                    b.Attendees.push_back(a.get<UserId>());
+        }
+
+        struct TSnapshot {
+            uint64_t Seq = 0;
+            nlohmann::json Meta;              // binary codec
+            std::vector<std::string> Records; // binary codec
+            nlohmann::json Json;              // json codec
+        };
+
+        TSnapshot BuildSnapshot() const {
+            TSnapshot snap;
+            snap.Seq = Seq;
+            if (Storage->RecordCodec() == ECodec::Binary) {
+                snap.Meta = {{"seq", Seq}, {"next_id", Ids->Peek()}, {"archived", ArchivedToJson()}};
+                snap.Records.reserve(Bookings.size());
+                for (auto const& kv : Bookings) {
+                    EncodeBooking(kv.second, snap.Records.emplace_back());
                 }
+                return snap;
+            }
+
+            snap.Json = nlohmann::json::object();
+            snap.Json["seq"] = Seq;
+            snap.Json["next_id"] = Ids->Peek();
+            snap.Json["archived"] = ArchivedToJson();
+            snap.Json["bookings"] = nlohmann::json::array();
+            for (auto const& kv : Bookings) {
+                snap.Json["bookings"].push_back(BookingToJson(kv.second));
+            }
+            return snap;
+        }
+
+        // {"<segment seq>": [booking ids...]}, one key per archive run.
+        nlohmann::json ArchivedToJson() const {
+            std::map<uint64_t, std::vector<BookingId>> bySeq;
+            for (auto const& [id, seq] : Archived) {
+                bySeq[seq].push_back(id);
             }
-            if (j.contains("resources") && j["resources"].is_array()) {
-                b.Resources.clear();
-                for (auto const& r : j["resources"]) {
-                    b.Resources.push_back(TResource{r.get<std::string>()});
+            nlohmann::json j = nlohmann::json::object();
+            for (auto& [seq, ids] : bySeq) {
+                std::sort(ids.begin(), ids.end());
+                j[std::to_string(seq)] = std::move(ids);
+            }
+            return j;
+        }
+
+        void LoadArchived(const nlohmann::json& j) {
+            for (auto const& [seq, ids] : j.items()) {
+                uint64_t s = std::stoull(seq);
+                for (auto const& id : ids) {
+                    Archived[id.get<BookingId>()] = s;
                 }
             }
         }
 
+        void SaveSnapshot(const TSnapshot& snap) {
+            NMetrics::TScope timer(NMetrics::ETimer::Snapshot);
+            if (Storage->RecordCodec() == ECodec::Binary) {
+                Storage->SaveRecords(snap.Meta, snap.Records);
+            } else {
+                Storage->SaveState(snap.Json);
+            }
+        }
+
     private:
         std::shared_ptr<IStorage> Storage;
-        std::mutex Mutex_;
+        TRepositoryOptions Options;
+        std::shared_ptr<TIdAllocator> Ids;
+        std::shared_mutex Mutex_;
+        std::mutex CheckpointMutex_;
+        std::mutex ArchiveMutex_; // one archive run at a time
+        uint64_t Seq = 0;
+        size_t JournalOps = 0;
+        size_t JournalBytes = 0;
         std::unordered_map<BookingId, TBooking> Bookings;
+        std::unordered_map<RoomId, TRoomIndex> RoomIndex;
+        TResourceInterner Resources;
+        std::unordered_map<TResourceInterner::THandle, std::unordered_set<BookingId>> ByResource;
+        // Seq of the last write per room and resource; never shrink, so a
+        // room that empties and fills again still moves forward.
+        std::unordered_map<RoomId, uint64_t> RoomVersions;
+        std::unordered_map<TResourceInterner::THandle, uint64_t> ResourceVersions;
+        std::vector<TArchiveSegment> Archives; // by Seq
+        // Segment seq holding the committed copy of each archived booking;
+        // segments may also hold copies whose removal never committed.
+        std::unordered_map<BookingId, uint64_t> Archived;
     };
 
     struct ICommand {
@@ -152,61 +1137,159 @@ namespace NBooking {
         virtual void Execute() = 0;
         virtual void Undo() = 0;
         virtual std::string Describe() const = 0;
+        // Memory held by the command, charged against the history budget.
+        virtual size_t Bytes() const = 0;
+    };
+
+    // Bookings kept by history commands, binary-encoded back to back in one
+    // buffer instead of one deep TBooking copy per command.
+    class TRecordPool {
+    public:
+        size_t Add(const TBooking& b) {
+            Offsets.push_back(static_cast<uint32_t>(Data.size()));
+            EncodeBooking(b, Data);
+            return Offsets.size() - 1;
+        }
+
+        TBooking Get(size_t i) const {
+            size_t from = Offsets[i];
+            size_t to = i + 1 < Offsets.size() ? Offsets[i + 1] : Data.size();
+            TBooking b{};
+            DecodeBooking(std::string_view(Data).substr(from, to - from), b);
+            return b;
+        }
+
+        std::vector<TBooking> All() const {
+            std::vector<TBooking> out;
+            out.reserve(size());
+            for (size_t i = 0; i < size(); ++i) {
+                out.push_back(Get(i));
+            }
+            return out;
+        }
+
+        size_t size() const {
+            return Offsets.size();
+        }
+
+        size_t Bytes() const {
+            return Data.capacity() + Offsets.capacity() * sizeof(uint32_t);
+        }
+
+        void ShrinkToFit() {
+            Data.shrink_to_fit();
+            Offsets.shrink_to_fit();
+        }
+
+    private:
+        std::string Data;
+        std::vector<uint32_t> Offsets;
     };
 
     class TCreateBookingCommand: public ICommand {
     public:
-        TCreateBookingCommand(IRepository& repo, TBooking booking)
+        TCreateBookingCommand(IRepository& repo, TBooking booking, TListCache* lists = nullptr)
             : Repo(repo)
-            , Booking(std::move(booking)) {
+            , Lists(lists)
+            , Pending(std::make_unique<TBooking>(std::move(booking)))
+            , Room(Pending->RoomIdInternal) {
         }
 
         void Execute() override {
-            if (!Executed) {
-                Booking.Id = Repo.CreateBooking(Booking);
-                Executed = true;
+            if (Pending) {
+                Created(Repo.CreateBooking(*Pending));
             } else {
-                Repo.UpdateBooking(Booking);
+                Repo.RestoreBooking(Record.Get(0));
+            }
+            if (Lists) {
+                Lists->Invalidate(Room);
             }
         }
 
+        // First execution as an optimistic commit; false, with nothing
+        // changed, when the check no longer holds.
+        bool ExecuteIf(const TVersionCheck& check) {
+            TBookingBatch batch;
+            batch.Create.push_back(*Pending);
+            auto ids = Repo.TryApplyBatch(std::move(batch), check);
+            if (!ids) {
+                return false;
+            }
+            Created(ids->front());
+            if (Lists) {
+                Lists->Invalidate(Room);
+            }
+            return true;
+        }
+
         void Undo() override {
-            if (Executed) {
-                Repo.RemoveBooking(Booking.Id);
+            if (!Pending) {
+                Repo.RemoveBooking(Id);
+                if (Lists) {
+                    Lists->Invalidate(Room);
+                }
             }
         }
 
         std::string Describe() const {
-            return "Create booking id=" + std::to_string(Booking.Id) + " title=\"" + Booking.Title + "\"";
+            auto title = Pending ? Pending->Title : Record.Get(0).Title;
+            return "Create booking id=" + std::to_string(Id) + " title=\"" + *title + "\"";
+        }
+
+        size_t Bytes() const override {
+            return sizeof(*this) + Record.Bytes();
         }
 
         BookingId id() const {
-            return Booking.Id;
+            return Id;
+        }
+
+    private:
+        void Created(BookingId id) {
+            Pending->Id = id;
+            Id = id;
+            Record.Add(*Pending);
+            Record.ShrinkToFit();
+            Pending.reset();
         }
 
     private:
         IRepository& Repo;
-        TBooking Booking;
-        bool Executed = false;
+        TListCache* Lists;
+        std::unique_ptr<TBooking> Pending; // until the first Execute
+        TRecordPool Record;
+        RoomId Room;
+        BookingId Id = 0;
     };
 
     class TRemoveBookingCommand: public ICommand {
     public:
-        TRemoveBookingCommand(IRepository& repo, BookingId id)
+        TRemoveBookingCommand(IRepository& repo, BookingId id, TListCache* lists = nullptr)
             : Repo(repo)
+            , Lists(lists)
             , Id(id) {
         }
 
         void Execute() override {
-            Old = Repo.GetBooking(Id);
-            if (Old) {
+            auto old = Repo.GetBooking(Id);
+            Old = TRecordPool{};
+            if (old) {
+                Old.Add(*old);
+                Old.ShrinkToFit();
+                Room = old->RoomIdInternal;
                 Repo.RemoveBooking(Id);
+                if (Lists) {
+                    Lists->Invalidate(Room);
+                }
             }
         }
 
         void Undo() override {
-            if (Old) {
-                Repo.CreateBooking(*Old);
+            if (Old.size() > 0) {
+                Repo.RestoreBooking(Old.Get(0));
+                if (Lists) {
+                    Lists->Invalidate(Room);
+                }
             }
         }
 
@@ -214,10 +1297,135 @@ namespace NBooking {
             return "Cancel booking id=" + std::to_string(Id);
         }
 
+        size_t Bytes() const override {
+            return sizeof(*this) + Old.Bytes();
+        }
+
     private:
         IRepository& Repo;
+        TListCache* Lists;
         BookingId Id;
-        std::optional<TBooking> Old;
+        RoomId Room = 0;
+        TRecordPool Old;
+    };
+
+    // One undo step for a whole batch import: the bookings it created and
+    // the ones it preempted go back and forth together.
+    class TBatchCreateCommand: public ICommand {
+    public:
+        TBatchCreateCommand(IRepository& repo, std::vector<TBooking> bookings, std::vector<BookingId> preempt, TListCache* lists = nullptr)
+            : Repo(repo)
+            , Lists(lists)
+            , Pending(std::move(bookings))
+            , PreemptIds(std::move(preempt)) {
+        }
+
+        void Execute() override {
+            if (!Executed) {
+                First(nullptr);
+                return;
+            }
+            TBookingBatch batch;
+            batch.Remove = PreemptIds;
+            batch.Restore = Created.All();
+            Repo.ApplyBatch(std::move(batch));
+            if (Lists) {
+                Lists->Invalidate(Rooms);
+            }
+        }
+
+        // First execution as an optimistic commit; false, with nothing
+        // changed, when the check no longer holds. The preempted bookings
+        // are read before the commit, and they are in the checked scope:
+        // if one changed in between, the commit fails.
+        bool ExecuteIf(const TVersionCheck& check) {
+            return First(&check);
+        }
+
+        void Undo() override {
+            if (!Executed) {
+                return;
+            }
+            TBookingBatch batch;
+            batch.Remove = Ids;
+            batch.Restore = Preempted.All();
+            Repo.ApplyBatch(std::move(batch));
+            if (Lists) {
+                Lists->Invalidate(Rooms);
+            }
+        }
+
+        std::string Describe() const {
+            size_t n = Executed ? Ids.size() : Pending.size();
+            if (Executed && n == 1 && !PreemptIds.empty()) {
+                return "Create booking id=" + std::to_string(Ids[0]) + " preempting " + std::to_string(PreemptIds.size());
+            }
+            return "Create batch of " + std::to_string(n) + " bookings";
+        }
+
+        size_t Bytes() const override {
+            return sizeof(*this) + Created.Bytes() + Preempted.Bytes() + (Ids.capacity() + PreemptIds.capacity()) * sizeof(BookingId) +
+                   Rooms.capacity() * sizeof(RoomId);
+        }
+
+        const std::vector<BookingId>& ids() const {
+            return Ids;
+        }
+
+    private:
+        bool First(const TVersionCheck* check) {
+            TRecordPool preempted;
+            std::vector<RoomId> rooms;
+            for (BookingId id : PreemptIds) {
+                if (auto old = Repo.GetBooking(id)) {
+                    preempted.Add(*old);
+                    rooms.push_back(old->RoomIdInternal);
+                }
+            }
+            for (auto const& b : Pending) {
+                rooms.push_back(b.RoomIdInternal);
+            }
+            std::sort(rooms.begin(), rooms.end());
+            rooms.erase(std::unique(rooms.begin(), rooms.end()), rooms.end());
+
+            TBookingBatch batch;
+            batch.Remove = PreemptIds;
+            batch.Create = Pending;
+            if (check) {
+                auto ids = Repo.TryApplyBatch(std::move(batch), *check);
+                if (!ids) {
+                    return false;
+                }
+                Ids = std::move(*ids);
+            } else {
+                Ids = Repo.ApplyBatch(std::move(batch));
+            }
+            for (size_t i = 0; i < Ids.size(); ++i) {
+                Pending[i].Id = Ids[i];
+                Created.Add(Pending[i]);
+            }
+            Pending = {};
+            Preempted = std::move(preempted);
+            Rooms = std::move(rooms);
+            Created.ShrinkToFit();
+            Preempted.ShrinkToFit();
+            Executed = true;
+            if (Lists) {
+                Lists->Invalidate(Rooms);
+            }
+            return true;
+        }
+
+    private:
+        IRepository& Repo;
+        TListCache* Lists;
+        std::vector<TBooking> Pending;
+        std::vector<BookingId> PreemptIds;
+        std::vector<BookingId> Ids;
+        std::vector<RoomId> Rooms; // touched by the batch, for invalidation
+        TRecordPool Created;
+        TRecordPool Preempted;
+        bool Executed = false;
     };
 
-} // namespace NBooking
\ No newline at end of file
+} // namespace NBooking
@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <ostream>
+
+#include "Command.hpp"
+
+namespace NBooking {
+
+    // Bounded-memory reads over the whole repository: one page of bookings
+    // is held at a time, so exports start writing after the first page.
+    struct TExportOptions {
+        // Only bookings with an instance in [From, To); either bound may be open.
+        std::optional<std::chrono::system_clock::time_point> From{};
+        std::optional<std::chrono::system_clock::time_point> To{};
+        size_t PageSize = 1024;
+    };
+
+    // Calls f for each booking in id order until it returns false.
+    // Returns the number of bookings visited.
+    template <class F>
+    size_t VisitBookings(IRepository& repo, F&& f, const TExportOptions& options = {}) {
+        auto to = options.To.value_or(std::chrono::system_clock::time_point::max());
+        bool windowed = options.From || options.To;
+        size_t visited = 0;
+        std::optional<BookingId> cursor = 1;
+        while (cursor) {
+            auto page = repo.ListPage(*cursor, options.PageSize);
+            for (auto const& b : page.Items) {
+                // No instance starts before b.Start, which keeps an open From
+                // away from time_point::min arithmetic.
+                if (windowed && Occurrences(b, options.From.value_or(b.Start), to).empty()) {
+                    continue;
+                }
+                ++visited;
+                if (!f(b)) {
+                    return visited;
+                }
+            }
+            cursor = page.Next;
+        }
+        return visited;
+    }
+
+    // A json array of BookingToJson objects, written page by page.
+    size_t ExportJson(IRepository& repo, std::ostream& out, const TExportOptions& options = {});
+
+    // "BKX1", then one varint length and EncodeBooking record per booking.
+    size_t ExportBinary(IRepository& repo, std::ostream& out, const TExportOptions& options = {});
+    // Reads an ExportBinary stream one booking at a time.
+    size_t ReadBinaryExport(std::istream& in, const std::function<void(TBooking)>& f);
+
+} // namespace NBooking
@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "Metrics.hpp"
+
+namespace NBooking {
+
+    // Expanded ListBookings results per room. A miss expands the request
+    // window widened to whole hours; any later window it covers, such as a
+    // panel polling "now +- 24h" within the same hour, is cut out of it.
+    //
+    // Every write to a room must call Invalidate(room) after the repository
+    // has changed. A reader notes the room's generation before expanding and
+    // only stores its result if no invalidation happened meanwhile, so a
+    // write racing a miss can never leave a stale entry behind.
+    class TListCache {
+    public:
+        static constexpr size_t WINDOWS_PER_ROOM = 4;
+
+        // expand(from, to) lists the room's instances overlapping [from, to).
+        template <class F>
+        std::vector<TBooking> Get(RoomId room,
+                                  std::chrono::system_clock::time_point from,
+                                  std::chrono::system_clock::time_point to,
+                                  F&& expand) {
+            auto [wf, wt] = Align(from, to);
+            uint64_t generation = 0;
+            {
+                std::shared_lock lk(Mutex_);
+                if (auto it = Rooms.find(room); it != Rooms.end()) {
+                    generation = it->second.Generation;
+                    for (auto const& w : it->second.Windows) {
+                        if (w.From <= from && to <= w.To) {
+                            auto items = w.Items;
+                            lk.unlock();
+                            NMetrics::Add(NMetrics::ECounter::ListCacheHits);
+                            return Cut(*items, from, to);
+                        }
+                    }
+                }
+            }
+            NMetrics::Add(NMetrics::ECounter::ListCacheMisses);
+            auto items = std::make_shared<const std::vector<TBooking>>(expand(wf, wt));
+            {
+                std::unique_lock lk(Mutex_);
+                auto& r = Rooms[room];
+                if (r.Generation == generation) {
+                    if (r.Windows.size() >= WINDOWS_PER_ROOM) {
+                        r.Windows.pop_front();
+                    }
+                    r.Windows.push_back({wf, wt, items});
+                }
+            }
+            return Cut(*items, from, to);
+        }
+
+        void Invalidate(RoomId room) {
+            std::unique_lock lk(Mutex_);
+            auto& r = Rooms[room];
+            ++r.Generation;
+            r.Windows.clear();
+        }
+
+        template <class TRooms>
+        void Invalidate(const TRooms& rooms) {
+            std::unique_lock lk(Mutex_);
+            for (RoomId room : rooms) {
+                auto& r = Rooms[room];
+                ++r.Generation;
+                r.Windows.clear();
+            }
+        }
+
+    private:
+        struct TWindow {
+            std::chrono::system_clock::time_point From;
+            std::chrono::system_clock::time_point To;
+            std::shared_ptr<const std::vector<TBooking>> Items;
+        };
+
+        struct TRoom {
+            uint64_t Generation = 0;
+            std::deque<TWindow> Windows;
+        };
+
+        static std::pair<std::chrono::system_clock::time_point, std::chrono::system_clock::time_point>
+        Align(std::chrono::system_clock::time_point from, std::chrono::system_clock::time_point to) {
+            using namespace std::chrono;
+            auto wf = floor<hours>(from);
+            auto wt = ceil<hours>(to);
+            return {wf, std::max(wt, wf + hours(1))};
+        }
+
+        static std::vector<TBooking> Cut(const std::vector<TBooking>& items,
+                                         std::chrono::system_clock::time_point from,
+                                         std::chrono::system_clock::time_point to) {
+            std::vector<TBooking> out;
+            for (auto const& b : items) {
+                if (IntervalsOverlap(b.Start, b.End, from, to)) {
+                    out.push_back(b);
+                }
+            }
+            return out;
+        }
+
+    private:
+        std::shared_mutex Mutex_;
+        std::unordered_map<RoomId, TRoom> Rooms;
+    };
+
+} // namespace NBooking
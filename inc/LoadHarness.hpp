@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BookingManager.hpp"
+
+namespace NBooking::NLoad {
+
+    // Trace line: "<client> <command>", the command in the CLI grammar of
+    // booking_app, '#' starts a comment. create takes two optional tails:
+    //   create <room> <hours> <title> <descr> [<start_hours> [daily|weekly <days>]]
+    // start_hours counts from the start of the replay (the CLI books "now").
+    // "cancel last" cancels the client's most recent booking from this run.
+    enum class EOp : uint8_t {
+        Login,
+        Create,
+        List,
+        Cancel,
+        Undo,
+        Redo,
+        COUNT
+    };
+
+    constexpr size_t OPS = static_cast<size_t>(EOp::COUNT);
+
+    const char* Name(EOp op);
+
+    struct TTraceOp {
+        size_t Client = 0;
+        EOp Op = EOp::List;
+        TUser User{};   // login
+        RoomId Room = 0; // create, list
+        int Hours = 1;
+        int StartHours = 0;
+        TRecurrence::Type Recurrence = TRecurrence::Type::None;
+        int RepeatDays = 0;
+        std::string Title = "load";
+        std::string Description = "-";
+        std::optional<BookingId> CancelId; // empty for "cancel last"
+    };
+
+    TTraceOp ParseLine(std::string_view line);
+    std::string FormatLine(const TTraceOp& op);
+    std::vector<TTraceOp> ReadTrace(std::istream& in);
+    void WriteTrace(std::ostream& out, const std::vector<TTraceOp>& trace);
+
+    // Synthetic traces. Every client logs in first, then runs OpsPerClient
+    // commands drawn from the mix. HotPercent of the room picks go to the
+    // first HotRooms rooms, RecurringPercent of creates are series.
+    struct TLoadProfile {
+        size_t Clients = 16;
+        size_t OpsPerClient = 1000;
+        size_t Rooms = 100;
+        size_t HotRooms = 0;
+        unsigned HotPercent = 0;
+        unsigned RecurringPercent = 0;
+        unsigned CreatePercent = 50;
+        unsigned ListPercent = 35;
+        unsigned CancelPercent = 10; // the rest is undo
+        uint64_t Seed = 1;
+    };
+
+    // "uniform", "hot-rooms" or "recurring"; throws on other names.
+    TLoadProfile Profile(std::string_view name);
+    std::vector<TTraceOp> Synthesize(const TLoadProfile& profile);
+
+    struct TOpStats {
+        size_t Count = 0;
+        size_t Ok = 0; // created, cancelled, undone; every list and login
+        uint64_t P50Ns = 0;
+        uint64_t P99Ns = 0;
+        uint64_t P999Ns = 0;
+        uint64_t MaxNs = 0;
+    };
+
+    struct TLoadReport {
+        size_t Threads = 0;
+        double Seconds = 0;
+        std::array<TOpStats, OPS> PerOp{};
+        TOpStats All;
+
+        double Throughput() const {
+            return Seconds > 0 ? static_cast<double>(All.Count) / Seconds : 0;
+        }
+
+        std::string ToString() const;
+    };
+
+    // Clients are spread over the threads by Client % threads; each thread
+    // runs its clients' commands in trace order, all threads start together.
+    TLoadReport Replay(TBookingManager& mgr, const std::vector<TTraceOp>& trace, size_t threads);
+
+} // namespace NBooking::NLoad
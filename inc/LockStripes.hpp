@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory_resource>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+namespace NBooking {
+
+    // Fixed set of mutexes that rooms and resources hash onto. A caller locks
+    // every stripe it needs in one call; stripes are taken in ascending order
+    // so two overlapping lock sets can never deadlock.
+    //
+    // Stripes are shared mutexes: optimistic writers, which validate their
+    // commit anyway, hold them shared, and a writer that must not lose its
+    // commit holds them exclusively. Shared lockers back off while an
+    // exclusive one is waiting, so the latter is not starved.
+    class TLockStripes {
+    public:
+        class TGuard {
+        public:
+            TGuard() = default;
+
+            TGuard(TLockStripes* owner, std::pmr::vector<size_t> stripes, bool shared)
+                : Owner(owner)
+                , Stripes(std::move(stripes))
+                , Shared(shared) {
+                if (Shared) {
+                    for (size_t s : Stripes) {
+                        while (Owner->Exclusive[s].load() > 0) {
+                            std::this_thread::yield();
+                        }
+                    }
+                    for (size_t s : Stripes) {
+                        Owner->Mutexes[s].lock_shared();
+                    }
+                    return;
+                }
+                for (size_t s : Stripes) {
+                    Owner->Exclusive[s].fetch_add(1);
+                }
+                for (size_t s : Stripes) {
+                    Owner->Mutexes[s].lock();
+                }
+            }
+
+            TGuard(TGuard&& other) noexcept
+                : Owner(std::exchange(other.Owner, nullptr))
+                , Stripes(std::move(other.Stripes))
+                , Shared(other.Shared) {
+            }
+
+            TGuard& operator=(TGuard&& other) noexcept {
+                if (this != &other) {
+                    Unlock();
+                    Owner = std::exchange(other.Owner, nullptr);
+                    Stripes = std::move(other.Stripes);
+                    Shared = other.Shared;
+                }
+                return *this;
+            }
+
+            TGuard(const TGuard&) = delete;
+            TGuard& operator=(const TGuard&) = delete;
+
+            ~TGuard() {
+                Unlock();
+            }
+
+            void Unlock() {
+                if (!Owner) {
+                    return;
+                }
+                for (auto it = Stripes.rbegin(); it != Stripes.rend(); ++it) {
+                    if (Shared) {
+                        Owner->Mutexes[*it].unlock_shared();
+                    } else {
+                        Owner->Mutexes[*it].unlock();
+                        Owner->Exclusive[*it].fetch_sub(1);
+                    }
+                }
+                Owner = nullptr;
+            }
+
+        private:
+            TLockStripes* Owner = nullptr;
+            std::pmr::vector<size_t> Stripes;
+            bool Shared = false;
+        };
+
+        explicit TLockStripes(size_t count)
+            : Mutexes(count)
+            , Exclusive(count) {
+        }
+
+        size_t ForRoom(RoomId room) const {
+            return std::hash<RoomId>{}(room) % Mutexes.size();
+        }
+
+        size_t ForResource(const std::string& id) const {
+            return std::hash<std::string>{}(id) % Mutexes.size();
+        }
+
+        // Stripes guarding bookings of the room and of the given resources.
+        std::pmr::vector<size_t> ForBooking(RoomId room,
+                                            const std::vector<TResource>& resources,
+                                            std::pmr::memory_resource* mr = std::pmr::get_default_resource()) const {
+            std::pmr::vector<size_t> out(mr);
+            out.reserve(resources.size() + 1);
+            out.push_back(ForRoom(room));
+            for (auto const& r : resources) {
+                out.push_back(ForResource(r.Id));
+            }
+            return out;
+        }
+
+        TGuard Lock(std::pmr::vector<size_t> stripes) {
+            Normalize(stripes);
+            return TGuard(this, std::move(stripes), false);
+        }
+
+        TGuard LockShared(std::pmr::vector<size_t> stripes) {
+            Normalize(stripes);
+            return TGuard(this, std::move(stripes), true);
+        }
+
+        // Exclusive holders and waiters of the stripe, the count shared
+        // lockers back off on.
+        uint32_t ExclusiveLockers(size_t stripe) const {
+            return Exclusive[stripe].load();
+        }
+
+    private:
+        static void Normalize(std::pmr::vector<size_t>& stripes) {
+            std::sort(stripes.begin(), stripes.end());
+            stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+        }
+
+    private:
+        std::vector<std::shared_mutex> Mutexes;
+        std::vector<std::atomic<uint32_t>> Exclusive; // exclusive holders and waiters
+    };
+
+} // namespace NBooking
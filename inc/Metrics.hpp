@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Process-wide latency histograms and counters of the booking hot paths.
+// Pulled with NMetrics::Snapshot(); building with -DBOOKING_METRICS=OFF
+// (BOOKING_NO_METRICS) turns every recording call into an empty inline.
+namespace NBooking::NMetrics {
+
+#ifdef BOOKING_NO_METRICS
+    constexpr bool ENABLED = false;
+#else
+    constexpr bool ENABLED = true;
+#endif
+
+    enum class ETimer : uint8_t {
+        Create,          // whole CreateBooking
+        CreateBatch,     // whole CreateBookings
+        Cancel,
+        List,
+        Undo,
+        Redo,
+        LockWait,        // waiting for room/resource stripes
+        HistoryLockWait, // waiting for HistoryMutex_
+        Load,            // fetching existing occurrences
+        Instances,       // expanding the requested series
+        Resolve,         // conflict strategy
+        Persist,         // executing the command against the repository
+        Journal,         // journal append handed to the storage
+        Snapshot,        // snapshot write
+        Fsync,
+        COUNT
+    };
+
+    enum class ECounter : uint8_t {
+        Created,
+        Rejected,
+        Preempted, // bookings removed by preemption
+        AutoBumped,
+        JournalBytes, // written to journal files
+        SnapshotBytes,
+        ListCacheHits,
+        ListCacheMisses,
+        VersionConflicts, // optimistic creates redone after a concurrent write
+        COUNT
+    };
+
+    constexpr size_t TIMERS = static_cast<size_t>(ETimer::COUNT);
+    constexpr size_t COUNTERS = static_cast<size_t>(ECounter::COUNT);
+
+    const char* Name(ETimer t);
+    const char* Name(ECounter c);
+
+    struct TTimerStats {
+        uint64_t Count = 0;
+        uint64_t TotalNs = 0;
+        uint64_t MaxNs = 0;
+        // Upper bound of the power-of-two bucket holding the quantile,
+        // capped at MaxNs.
+        uint64_t P50Ns = 0;
+        uint64_t P99Ns = 0;
+    };
+
+    struct TStats {
+        std::array<TTimerStats, TIMERS> Timers{};
+        std::array<uint64_t, COUNTERS> Counters{};
+        std::vector<std::pair<std::string, uint64_t>> RejectsByStrategy;
+
+        const TTimerStats& operator[](ETimer t) const {
+            return Timers[static_cast<size_t>(t)];
+        }
+        uint64_t operator[](ECounter c) const {
+            return Counters[static_cast<size_t>(c)];
+        }
+        uint64_t Rejects(const std::string& strategy) const;
+
+        // One line per non-empty timer and counter, for the CLI.
+        std::string ToString() const;
+    };
+
+    TStats Snapshot();
+    void Reset();
+
+    namespace NDetail {
+        void Record(ETimer t, uint64_t ns);
+        void Add(ECounter c, uint64_t n);
+        void Reject(const char* strategy);
+    } // namespace NDetail
+
+    inline void Record(ETimer t, std::chrono::steady_clock::duration d) {
+        if constexpr (ENABLED) {
+            NDetail::Record(t, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        }
+    }
+
+    inline void Add(ECounter c, uint64_t n = 1) {
+        if constexpr (ENABLED) {
+            NDetail::Add(c, n);
+        }
+    }
+
+    // strategy must be a string literal, it is kept by pointer.
+    inline void Reject(const char* strategy) {
+        if constexpr (ENABLED) {
+            NDetail::Reject(strategy);
+        }
+    }
+
+    // Records the time from construction to Stop() or destruction.
+    class TScope {
+    public:
+        explicit TScope(ETimer t)
+            : Timer(t) {
+            if constexpr (ENABLED) {
+                Start = std::chrono::steady_clock::now();
+            }
+        }
+
+        TScope(const TScope&) = delete;
+        TScope& operator=(const TScope&) = delete;
+
+        ~TScope() {
+            Stop();
+        }
+
+        void Stop() {
+            if constexpr (ENABLED) {
+                if (!Stopped) {
+                    Stopped = true;
+                    Record(Timer, std::chrono::steady_clock::now() - Start);
+                }
+            }
+        }
+
+    private:
+        ETimer Timer;
+        bool Stopped = false;
+        std::chrono::steady_clock::time_point Start{};
+    };
+
+    // Runs f() and records how long it took; for lock acquisition.
+    template <class F>
+    auto Timed(ETimer t, F&& f) {
+        TScope scope(t);
+        return f();
+    }
+
+} // namespace NBooking::NMetrics
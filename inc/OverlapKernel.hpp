@@ -0,0 +1,58 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace NBooking::NOverlap {
+
+    // Implementations of the bulk IntervalsOverlap test. The best one the
+    // CPU supports is picked once at startup; Scalar is always available.
+    enum class EKernel {
+        Scalar,
+        Avx2,
+        Avx512
+    };
+
+    bool Supported(EKernel kernel);
+    EKernel Active();
+    const char* Name(EKernel kernel);
+
+    // Stores into out the indices i < n with starts[i] < to && ends[i] > from,
+    // in increasing order; out must have room for n entries. Returns how many.
+    size_t Collect(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to, uint32_t* out);
+    size_t Collect(EKernel kernel, const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to, uint32_t* out);
+
+    // Index of the first overlapping interval, n when there is none.
+    size_t First(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to);
+    size_t First(EKernel kernel, const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to);
+
+    // Slices shorter than this are scanned inline, the kernel call does not
+    // pay off for them.
+    constexpr size_t DENSE_SLICE = 32;
+
+    // Calls f(i) for every i in [begin, last) overlapping [from, to), in
+    // order, until f returns false. Returns false when stopped early.
+    template <class F>
+    bool ForEach(const int64_t* starts, const int64_t* ends, size_t begin, size_t last, int64_t from, int64_t to, F&& f) {
+        if (last - begin < DENSE_SLICE) {
+            for (size_t i = begin; i < last; ++i) {
+                if (starts[i] < to && ends[i] > from && !f(i)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        constexpr size_t CHUNK = 256;
+        uint32_t hits[CHUNK];
+        for (size_t c = begin; c < last; c += CHUNK) {
+            size_t k = Collect(starts + c, ends + c, std::min(CHUNK, last - c), from, to, hits);
+            for (size_t j = 0; j < k; ++j) {
+                if (!f(c + hits[j])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+} // namespace NBooking::NOverlap
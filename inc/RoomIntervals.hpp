@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "common.hpp"
+#include "OverlapKernel.hpp"
+
+namespace NBooking {
+
+    // Hot part of a room's one-off bookings, kept as parallel arrays sorted
+    // by start: overlap scans touch only the starts and ends, never the
+    // booking objects. Times are stored as system_clock ticks.
+    class TRoomIntervals {
+    public:
+        using TTicks = int64_t;
+        static_assert(sizeof(std::chrono::system_clock::rep) == sizeof(TTicks));
+
+        static TTicks Ticks(std::chrono::system_clock::time_point tp) {
+            return tp.time_since_epoch().count();
+        }
+
+        static std::chrono::system_clock::time_point TimePoint(TTicks t) {
+            return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(t));
+        }
+
+        void Insert(BookingId id,
+                    std::chrono::system_clock::time_point start,
+                    std::chrono::system_clock::time_point end,
+                    int priority) {
+            TTicks s = Ticks(start);
+            size_t i = std::upper_bound(Starts.begin(), Starts.end(), s) - Starts.begin();
+            Starts.insert(Starts.begin() + i, s);
+            Ends.insert(Ends.begin() + i, Ticks(end));
+            Ids.insert(Ids.begin() + i, id);
+            Priorities.insert(Priorities.begin() + i, priority);
+            MaxLength = std::max(MaxLength, Ticks(end) - s);
+        }
+
+        // Replaces the contents with items in one pass; for bulk loads,
+        // where one Insert per item would shift the arrays every time.
+        void Assign(std::vector<TOccurrence> items) {
+            std::stable_sort(items.begin(), items.end(), [](const TOccurrence& a, const TOccurrence& b) {
+                return a.Start < b.Start;
+            });
+            Starts.resize(items.size());
+            Ends.resize(items.size());
+            Ids.resize(items.size());
+            Priorities.resize(items.size());
+            MaxLength = 0;
+            for (size_t i = 0; i < items.size(); ++i) {
+                Starts[i] = Ticks(items[i].Start);
+                Ends[i] = Ticks(items[i].End);
+                Ids[i] = items[i].Id;
+                Priorities[i] = items[i].OwnerPriority;
+                MaxLength = std::max(MaxLength, Ends[i] - Starts[i]);
+            }
+        }
+
+        bool Erase(BookingId id, std::chrono::system_clock::time_point start) {
+            TTicks s = Ticks(start);
+            size_t i = std::lower_bound(Starts.begin(), Starts.end(), s) - Starts.begin();
+            for (; i < Starts.size() && Starts[i] == s; ++i) {
+                if (Ids[i] == id) {
+                    Starts.erase(Starts.begin() + i);
+                    Ends.erase(Ends.begin() + i);
+                    Ids.erase(Ids.begin() + i);
+                    Priorities.erase(Priorities.begin() + i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Calls f(i) for every interval overlapping [from, to), in start order.
+        // Nothing starting before from - MaxLength can reach into the window.
+        template <class F>
+        void ForEachOverlap(std::chrono::system_clock::time_point from,
+                            std::chrono::system_clock::time_point to,
+                            F&& f) const {
+            TTicks lo = Ticks(from);
+            TTicks hi = Ticks(to);
+            size_t i = std::lower_bound(Starts.begin(), Starts.end(), lo - MaxLength) - Starts.begin();
+            size_t last = std::lower_bound(Starts.begin() + i, Starts.end(), hi) - Starts.begin();
+            NOverlap::ForEach(Starts.data(), Ends.data(), i, last, lo, hi, [&](size_t k) {
+                f(k);
+                return true;
+            });
+        }
+
+        BookingId IdAt(size_t i) const {
+            return Ids[i];
+        }
+
+        TOccurrence At(size_t i) const {
+            return {TimePoint(Starts[i]), TimePoint(Ends[i]), Ids[i], Priorities[i]};
+        }
+
+        size_t size() const {
+            return Starts.size();
+        }
+
+        bool empty() const {
+            return Starts.empty();
+        }
+
+        size_t Bytes() const {
+            return (Starts.capacity() + Ends.capacity()) * sizeof(TTicks) +
+                   Ids.capacity() * sizeof(BookingId) + Priorities.capacity() * sizeof(int);
+        }
+
+    private:
+        std::vector<TTicks> Starts;
+        std::vector<TTicks> Ends;
+        std::vector<BookingId> Ids;
+        std::vector<int> Priorities;
+        TTicks MaxLength = 0;
+    };
+
+} // namespace NBooking
@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Command.hpp"
+
+namespace NBooking {
+
+    // IRepository partitioned by RoomIdInternal over a fixed set of shards.
+    // Room-local calls go to one shard; resource lookups and ListAll are
+    // scatter-gathered over all of them. Shards are plain IRepository
+    // instances, so a remote one only has to implement that interface.
+    //
+    // Shards must not hand out the same booking id: local shards built from
+    // storages share one TIdAllocator. The shard count is part of the data
+    // layout and must not change for a given set of storages.
+    class TShardedRepository: public IRepository {
+    public:
+        explicit TShardedRepository(std::vector<std::shared_ptr<IRepository>> shards);
+        // One local TRepository per storage, all sharing options.Ids (or a
+        // fresh allocator when it is empty). Shards number their journals
+        // independently, so options.Feed is refused; build the shards with
+        // a feed each and use the constructor above.
+        explicit TShardedRepository(const std::vector<std::shared_ptr<IStorage>>& storages,
+                                    TRepositoryOptions options = {});
+
+        BookingId CreateBooking(TBooking b) override;
+        // Moving a booking to a room of another shard puts it there first
+        // and removes it from the old shard afterwards.
+        void UpdateBooking(TBooking b) override;
+        // Checked by the owning shard; a move to another shard cannot be
+        // checked and committed atomically and is refused. Scope versions
+        // are not offered, as a resource scope spans shards.
+        bool UpdateBookingIf(TBooking b, uint64_t version) override;
+        void RestoreBooking(TBooking b) override;
+        void RemoveBooking(BookingId id) override;
+        // Split into one batch per shard. When a shard fails, the parts
+        // already applied to other shards are reverted before rethrowing.
+        std::vector<BookingId> ApplyBatch(TBookingBatch batch) override;
+        std::optional<TBooking> GetBooking(BookingId id) override;
+        std::vector<TBooking> ListAll() override;
+        // Pages of all shards merged by id, cut where the shortest one ends.
+        TBookingPage ListPage(BookingId from, size_t limit) override;
+        std::vector<TBooking> ListInRange(RoomId room,
+                                          std::chrono::system_clock::time_point from,
+                                          std::chrono::system_clock::time_point to) override;
+        std::vector<TBooking> ListByResources(const std::vector<TResource>& resources,
+                                              std::chrono::system_clock::time_point from,
+                                              std::chrono::system_clock::time_point to) override;
+        std::vector<TOccurrence> RoomOccurrences(RoomId room,
+                                                 std::chrono::system_clock::time_point from,
+                                                 std::chrono::system_clock::time_point to) override;
+        std::vector<TOccurrence> ResourceOccurrences(const std::vector<TResource>& resources,
+                                                     std::chrono::system_clock::time_point from,
+                                                     std::chrono::system_clock::time_point to) override;
+        void AppendRoomOccurrences(RoomId room,
+                                   std::chrono::system_clock::time_point from,
+                                   std::chrono::system_clock::time_point to,
+                                   std::pmr::vector<TOccurrence>& out) override;
+        // Every shard archives into its own storage.
+        TArchiveResult Archive(std::chrono::system_clock::time_point horizon) override;
+        std::vector<TBooking> ListArchived(RoomId room,
+                                           std::chrono::system_clock::time_point from,
+                                           std::chrono::system_clock::time_point to) override;
+
+        size_t ShardCount() const {
+            return Shards.size();
+        }
+
+        size_t ShardOf(RoomId room) const {
+            return std::hash<RoomId>{}(room) % Shards.size();
+        }
+
+        IRepository& Shard(size_t i) {
+            return *Shards[i];
+        }
+
+    private:
+        // Booking id -> shard, striped so lookups for different ids rarely
+        // touch the same lock.
+        class TLocator {
+        public:
+            std::optional<size_t> Find(BookingId id) const;
+            void Set(BookingId id, size_t shard);
+            void Erase(BookingId id);
+
+        private:
+            struct TStripe {
+                mutable std::shared_mutex Mutex_;
+                std::unordered_map<BookingId, uint32_t> Shards;
+            };
+
+            TStripe& For(BookingId id) {
+                return Stripes[id % STRIPES];
+            }
+            const TStripe& For(BookingId id) const {
+                return Stripes[id % STRIPES];
+            }
+
+            static constexpr size_t STRIPES = 64;
+            std::array<TStripe, STRIPES> Stripes;
+        };
+
+        void Index();
+
+    private:
+        std::vector<std::shared_ptr<IRepository>> Shards;
+        TLocator Locator;
+    };
+
+} // namespace NBooking
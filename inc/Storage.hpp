@@ -1,15 +1,98 @@
 #pragma once
 #include "common.hpp"
+#include "Codec.hpp"
+#include <algorithm>
 #include <vector>
+#include <map>
 #include <mutex>
 #include <optional>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+// Snapshot laid out as a meta object plus one encoded booking per record.
+// Records point into storage owned by Mapping (e.g. an mmapped file).
+struct TSnapshotView {
+    nlohmann::json Meta;
+    std::vector<std::string_view> Records;
+    NBooking::ECodec Codec = NBooking::ECodec::Json;
+    std::shared_ptr<const void> Mapping;
+};
+
+// What one journal append wrote. Bytes is what the entries take in the
+// journal, 0 for backends that keep them unserialized. Ticket grows with
+// every append and is what SyncJournal waits on.
+struct TJournalWrite {
+    size_t Bytes = 0;
+    uint64_t Ticket = 0;
+};
 
 struct IStorage {
     virtual ~IStorage() = default;
     virtual void SaveState(const nlohmann::json& snapshot) = 0;
     virtual nlohmann::json LoadState() = 0;
-    virtual void AppendJournal(const nlohmann::json& entry) = 0;
+    // Appends return once the entry is written, not once it is durable;
+    // SyncJournal(ticket) returns when that append and every earlier one
+    // are. Callers append under their own lock and wait after releasing
+    // it, so concurrent writers can share one sync.
+    virtual TJournalWrite AppendJournal(const nlohmann::json& entry) = 0;
+    virtual void SyncJournal(uint64_t /*ticket*/) {
+    }
     virtual std::vector<nlohmann::json> LoadJournal() = 0;
+    // Drops journal entries with "seq" <= seq, they are covered by a snapshot.
+    virtual void TruncateJournal(uint64_t seq) = 0;
+    // Backends with a record layout hand out the snapshot without building a json tree.
+    virtual std::optional<TSnapshotView> MapState() {
+        return std::nullopt;
+    }
+
+    // Codec the backend keeps records in. Json backends are driven only
+    // through the json methods; others also take pre-encoded records.
+    virtual NBooking::ECodec RecordCodec() const {
+        return NBooking::ECodec::Json;
+    }
+    virtual void SaveRecords(const nlohmann::json& /*meta*/, const std::vector<std::string>& /*records*/) {
+        throw std::runtime_error("SaveRecords is not supported by this storage");
+    }
+    virtual TJournalWrite AppendJournalRecord(uint64_t /*seq*/, std::string_view /*record*/) {
+        throw std::runtime_error("AppendJournalRecord is not supported by this storage");
+    }
+    virtual std::vector<std::string> LoadJournalRecords() {
+        throw std::runtime_error("LoadJournalRecords is not supported by this storage");
+    }
+
+    // Archive segments: write-once record files of bookings moved out of
+    // the active set. Records are EncodeBooking bytes whatever RecordCodec
+    // says; meta is small and listed without reading the records.
+    virtual void WriteArchive(const std::string& /*name*/, const nlohmann::json& /*meta*/, const std::vector<std::string>& /*records*/) {
+        throw std::runtime_error("WriteArchive is not supported by this storage");
+    }
+    virtual std::vector<std::pair<std::string, nlohmann::json>> ListArchives() {
+        return {};
+    }
+    virtual std::optional<TSnapshotView> MapArchive(const std::string& /*name*/) {
+        return std::nullopt;
+    }
+
+    // Batched appends; backends that write the journal do it with one write.
+    virtual TJournalWrite AppendJournalBatch(const std::vector<nlohmann::json>& entries) {
+        TJournalWrite out;
+        for (auto const& e : entries) {
+            auto w = AppendJournal(e);
+            out.Bytes += w.Bytes;
+            out.Ticket = std::max(out.Ticket, w.Ticket);
+        }
+        return out;
+    }
+    virtual TJournalWrite AppendJournalRecords(const std::vector<std::pair<uint64_t, std::string>>& records) {
+        TJournalWrite out;
+        for (auto const& [seq, rec] : records) {
+            auto w = AppendJournalRecord(seq, rec);
+            out.Bytes += w.Bytes;
+            out.Ticket = std::max(out.Ticket, w.Ticket);
+        }
+        return out;
+    }
 };
 
 class TMemoryStorage: public IStorage {
@@ -26,9 +109,16 @@ public:
         return Snapshot;
     }
 
-    void AppendJournal(const nlohmann::json& entry) override {
+    TJournalWrite AppendJournal(const nlohmann::json& entry) override {
         std::scoped_lock lk(Mutex_);
         Journal.push_back(entry);
+        return {};
+    }
+
+    TJournalWrite AppendJournalBatch(const std::vector<nlohmann::json>& entries) override {
+        std::scoped_lock lk(Mutex_);
+        Journal.insert(Journal.end(), entries.begin(), entries.end());
+        return {};
     }
 
     std::vector<nlohmann::json> LoadJournal() override {
@@ -36,8 +126,46 @@ public:
         return Journal;
     }
 
+    void TruncateJournal(uint64_t seq) override {
+        std::scoped_lock lk(Mutex_);
+        std::erase_if(Journal, [seq](const nlohmann::json& e) {
+            return !e.contains("seq") || e["seq"].get<uint64_t>() <= seq;
+        });
+    }
+
+    void WriteArchive(const std::string& name, const nlohmann::json& meta, const std::vector<std::string>& records) override {
+        std::scoped_lock lk(Mutex_);
+        if (!Archives.try_emplace(name, meta, std::make_shared<const std::vector<std::string>>(records)).second) {
+            throw std::runtime_error("TMemoryStorage: archive " + name + " exists");
+        }
+    }
+
+    std::vector<std::pair<std::string, nlohmann::json>> ListArchives() override {
+        std::scoped_lock lk(Mutex_);
+        std::vector<std::pair<std::string, nlohmann::json>> out;
+        for (auto const& [name, a] : Archives) {
+            out.emplace_back(name, a.first);
+        }
+        return out;
+    }
+
+    std::optional<TSnapshotView> MapArchive(const std::string& name) override {
+        std::scoped_lock lk(Mutex_);
+        auto it = Archives.find(name);
+        if (it == Archives.end()) {
+            return std::nullopt;
+        }
+        TSnapshotView view;
+        view.Meta = it->second.first;
+        view.Codec = NBooking::ECodec::Binary;
+        view.Records.assign(it->second.second->begin(), it->second.second->end());
+        view.Mapping = it->second.second;
+        return view;
+    }
+
 private:
     nlohmann::json Snapshot = nlohmann::json::object();
     std::vector<nlohmann::json> Journal;
+    std::map<std::string, std::pair<nlohmann::json, std::shared_ptr<const std::vector<std::string>>>> Archives;
     std::mutex Mutex_;
 };
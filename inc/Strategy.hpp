@@ -1,9 +1,31 @@
 #pragma once
 #include "common.hpp"
+#include "OverlapKernel.hpp"
+#include <algorithm>
+#include <memory_resource>
 #include <optional>
+#include <span>
+#include <string>
 #include <vector>
 #include <iostream>
 
+// Batch imports stand their accepted items in for bookings under ids with
+// BATCH_ITEM set; the low bits are the item's index in the batch.
+inline constexpr BookingId BATCH_ITEM = BookingId(1) << 63;
+
+// Rejection message naming the booking or batch item in the way.
+inline std::string ConflictMessage(BookingId id) {
+    // One allocation for the message; rejections are the hot path under contention.
+    std::string msg;
+    msg.reserve(48);
+    if (id & BATCH_ITEM) {
+        msg.append("Conflict with batch item ").append(std::to_string(id & ~BATCH_ITEM));
+    } else {
+        msg.append("Conflict with booking id ").append(std::to_string(id));
+    }
+    return msg;
+}
+
 struct TConflictResolutionResult {
     bool ok;
     std::optional<std::string> Message;
@@ -12,70 +34,309 @@ struct TConflictResolutionResult {
     std::vector<BookingId> ToPreempt;
 };
 
+// Existing occurrences sorted by start. Overlaps with [s, e) can only come
+// from items starting in [s - MaxLength, e), so a lookup is a binary search
+// plus a scan over that slice. Starts and ends are mirrored into tick
+// arrays so dense slices go through the vector overlap kernel.
+// All three arrays use the memory resource of the items they are built
+// from, so a set built inside a request can live in the request arena.
+class TOccurrenceSet {
+public:
+    explicit TOccurrenceSet(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : Items_(mr)
+        , Starts_(mr)
+        , Ends_(mr) {
+    }
+
+    explicit TOccurrenceSet(std::pmr::vector<TOccurrence> items)
+        : Items_(std::move(items))
+        , Starts_(Items_.get_allocator())
+        , Ends_(Items_.get_allocator()) {
+        Build();
+    }
+
+    explicit TOccurrenceSet(const std::vector<TOccurrence>& items)
+        : Items_(items.begin(), items.end())
+        , Starts_(Items_.get_allocator())
+        , Ends_(Items_.get_allocator()) {
+        Build();
+    }
+
+    const std::pmr::vector<TOccurrence>& Items() const {
+        return Items_;
+    }
+
+    bool empty() const {
+        return Items_.empty();
+    }
+
+    // Keeps the set sorted; used to grow a working set across a batch.
+    void Insert(const TOccurrence& o) {
+        auto it = std::upper_bound(Items_.begin(), Items_.end(), o.Start, [](std::chrono::system_clock::time_point t, const TOccurrence& x) {
+            return t < x.Start;
+        });
+        auto pos = it - Items_.begin();
+        Items_.insert(it, o);
+        Starts_.insert(Starts_.begin() + pos, Ticks(o.Start));
+        Ends_.insert(Ends_.begin() + pos, Ticks(o.End));
+        MaxLength = std::max(MaxLength, o.End - o.Start);
+    }
+
+    void Erase(const std::vector<BookingId>& ids) {
+        size_t k = 0;
+        for (size_t i = 0; i < Items_.size(); ++i) {
+            if (std::find(ids.begin(), ids.end(), Items_[i].Id) != ids.end()) {
+                continue;
+            }
+            Items_[k] = Items_[i];
+            Starts_[k] = Starts_[i];
+            Ends_[k] = Ends_[i];
+            ++k;
+        }
+        Items_.resize(k);
+        Starts_.resize(k);
+        Ends_.resize(k);
+    }
+
+    // Index of the first item that may overlap an interval starting at start.
+    size_t LowerBound(std::chrono::system_clock::time_point start) const {
+        auto it = std::lower_bound(Items_.begin(), Items_.end(), start - MaxLength, [](const TOccurrence& o, std::chrono::system_clock::time_point t) {
+            return o.Start < t;
+        });
+        return static_cast<size_t>(it - Items_.begin());
+    }
+
+    // Calls f(item) for every item overlapping [start, end) in start order
+    // until f returns false.
+    template <class F>
+    void ForEachOverlap(std::chrono::system_clock::time_point start,
+                        std::chrono::system_clock::time_point end,
+                        F&& f) const {
+        ScanFrom(LowerBound(start), start, end, f);
+    }
+
+    // Merge-style sweep over instances sorted by start: calls f(i, item) for
+    // every overlapping pair until f returns false. The lower bound only moves
+    // forward, so the whole sweep is linear in both sequences plus the overlaps.
+    template <class F>
+    void SweepOverlaps(std::span<const TOccurrence> instances, F&& f) const {
+        size_t lo = 0;
+        for (size_t i = 0; i < instances.size(); ++i) {
+            auto const& inst = instances[i];
+            while (lo < Items_.size() && Items_[lo].Start < inst.Start - MaxLength) {
+                ++lo;
+            }
+            bool go = true;
+            ScanFrom(lo, inst.Start, inst.End, [&](const TOccurrence& e) {
+                go = f(i, e);
+                return go;
+            });
+            if (!go) {
+                return;
+            }
+        }
+    }
+
+    // Earliest start >= from at which [start, start + length) overlaps no item.
+    // Items are visited in start order, each one either ends before the
+    // candidate, pushes it to its end, or starts past the gap and stops the scan.
+    std::chrono::system_clock::time_point EarliestFit(std::chrono::system_clock::time_point from,
+                                                      std::chrono::system_clock::duration length) const {
+        auto start = from;
+        for (size_t i = LowerBound(from); i < Items_.size(); ++i) {
+            if (Items_[i].Start >= start + length) {
+                break;
+            }
+            start = std::max(start, Items_[i].End);
+        }
+        return start;
+    }
+
+private:
+    static int64_t Ticks(std::chrono::system_clock::time_point tp) {
+        return tp.time_since_epoch().count();
+    }
+
+    void Build() {
+        std::sort(Items_.begin(), Items_.end(), [](const TOccurrence& a, const TOccurrence& b) {
+            return a.Start < b.Start;
+        });
+        Starts_.reserve(Items_.size());
+        Ends_.reserve(Items_.size());
+        for (auto const& o : Items_) {
+            MaxLength = std::max(MaxLength, o.End - o.Start);
+            Starts_.push_back(Ticks(o.Start));
+            Ends_.push_back(Ticks(o.End));
+        }
+    }
+
+    template <class F>
+    void ScanFrom(size_t i,
+                  std::chrono::system_clock::time_point start,
+                  std::chrono::system_clock::time_point end,
+                  F&& f) const {
+        int64_t e = Ticks(end);
+        size_t last = std::lower_bound(Starts_.begin() + i, Starts_.end(), e) - Starts_.begin();
+        NBooking::NOverlap::ForEach(Starts_.data(), Ends_.data(), i, last, Ticks(start), e, [&](size_t k) {
+            return f(Items_[k]);
+        });
+    }
+
+private:
+    std::pmr::vector<TOccurrence> Items_;
+    std::pmr::vector<int64_t> Starts_;
+    std::pmr::vector<int64_t> Ends_;
+    std::chrono::system_clock::duration MaxLength{0};
+};
+
 struct IConflictStrategy {
     virtual ~IConflictStrategy() = default;
-    virtual TConflictResolutionResult Resolve(const TBooking& candidate, const std::vector<TBooking>& existing, const TUser& actor) = 0;
+    virtual TConflictResolutionResult Resolve(const TBooking& candidate, const TOccurrenceSet& existing, const TUser& actor) = 0;
+
+    // Label for metrics; must outlive the process (a string literal).
+    virtual const char* Name() const {
+        return "custom";
+    }
+
+    // Checks every requested instance (sorted by start) of request at once.
+    // The default resolves instance by instance: fails on the first
+    // rejection, merges preemptions and stops at the first suggested start.
+    virtual TConflictResolutionResult ResolveAll(const TBooking& request,
+                                                 std::span<const TOccurrence> instances,
+                                                 const TOccurrenceSet& existing,
+                                                 const TUser& actor) {
+        TConflictResolutionResult out{true, std::nullopt, std::nullopt, {}};
+        TBooking candidate = request;
+        for (auto const& inst : instances) {
+            candidate.Start = inst.Start;
+            candidate.End = inst.End;
+            auto res = Resolve(candidate, existing, actor);
+            if (!res.ok) {
+                return res;
+            }
+            for (BookingId id : res.ToPreempt) {
+                if (std::find(out.ToPreempt.begin(), out.ToPreempt.end(), id) == out.ToPreempt.end()) {
+                    out.ToPreempt.push_back(id);
+                }
+            }
+            if (res.Message) {
+                out.Message = res.Message;
+            }
+            if (res.SuggestedStart) {
+                out.SuggestedStart = res.SuggestedStart;
+                return out;
+            }
+        }
+        return out;
+    }
 };
 
 // RejectStrategy: отказывает на первом конфликте
 struct TRejectStrategy: public IConflictStrategy {
-    TConflictResolutionResult Resolve(const TBooking& candidate, const std::vector<TBooking>& existing, const TUser&) override {
-        for (auto const& e : existing) {
-            if (!(candidate.End <= e.Start || candidate.Start >= e.End)) {
-                return {false, std::string("Conflict with booking id ") + std::to_string(e.Id), std::nullopt, {}};
-            }
+    const char* Name() const override {
+        return "reject";
+    }
+
+    TConflictResolutionResult Resolve(const TBooking& candidate, const TOccurrenceSet& existing, const TUser&) override {
+        std::optional<BookingId> hit;
+        existing.ForEachOverlap(candidate.Start, candidate.End, [&](const TOccurrence& e) {
+            hit = e.Id;
+            return false;
+        });
+        return Result(hit);
+    }
+
+    TConflictResolutionResult ResolveAll(const TBooking&, std::span<const TOccurrence> instances, const TOccurrenceSet& existing, const TUser&) override {
+        std::optional<BookingId> hit;
+        existing.SweepOverlaps(instances, [&](size_t, const TOccurrence& e) {
+            hit = e.Id;
+            return false;
+        });
+        return Result(hit);
+    }
+
+private:
+    static TConflictResolutionResult Result(std::optional<BookingId> hit) {
+        if (hit) {
+            return {false, ConflictMessage(*hit), std::nullopt, {}};
         }
         return {true, std::nullopt, std::nullopt, {}};
     }
 };
 
+// AutoBumpStrategy: сдвигает бронирование в ближайший свободный промежуток
 struct TAutoBumpStrategy: public IConflictStrategy {
+    // A slot starting later than requested start + horizon is a rejection.
+    explicit TAutoBumpStrategy(std::optional<std::chrono::system_clock::duration> horizon = std::nullopt)
+        : Horizon(horizon) {
+    }
+
+    const char* Name() const override {
+        return "auto_bump";
+    }
+
     TConflictResolutionResult Resolve(
         const TBooking& b,
-        const std::vector<TBooking>& existing,
+        const TOccurrenceSet& existing,
         const TUser&) override {
-        auto start = b.Start;
-        auto dur = b.End - b.Start;
-
-        bool moved = true;
-        while (moved) {
-            moved = false;
-            for (auto const& e : existing) {
-                if (!(start + dur <= e.Start || start >= e.End)) {
-                    start = e.End;
-                    moved = true;
-                }
-            }
+        auto start = existing.EarliestFit(b.Start, b.End - b.Start);
+        if (Horizon && start - b.Start > *Horizon) {
+            return {false, "No free slot within horizon", std::nullopt, {}};
         }
-
         if (start != b.Start) {
             return {true, "Auto-bumped", start, {}};
         }
         return {true, std::nullopt, std::nullopt, {}};
     }
+
+private:
+    std::optional<std::chrono::system_clock::duration> Horizon;
 };
 
 // PreemptStrategy: если actor.priority > existing.user.priority -> удаление
 struct TPreemptStrategy: public IConflictStrategy {
+    const char* Name() const override {
+        return "preempt";
+    }
+
     TConflictResolutionResult Resolve(
         const TBooking& candidate,
-        const std::vector<TBooking>& existing,
+        const TOccurrenceSet& existing,
         const TUser& actor) override {
         std::vector<BookingId> to_preempt;
+        bool blocked = false;
+        existing.ForEachOverlap(candidate.Start, candidate.End, [&](const TOccurrence& e) {
+            return Visit(e, actor, to_preempt, blocked);
+        });
+        return Result(blocked, std::move(to_preempt));
+    }
 
-        for (auto const& e : existing) {
-            if (candidate.End <= e.Start || candidate.Start >= e.End) {
-                continue;
-            }
+    TConflictResolutionResult ResolveAll(const TBooking&, std::span<const TOccurrence> instances, const TOccurrenceSet& existing, const TUser& actor) override {
+        std::vector<BookingId> to_preempt;
+        bool blocked = false;
+        existing.SweepOverlaps(instances, [&](size_t, const TOccurrence& e) {
+            return Visit(e, actor, to_preempt, blocked);
+        });
+        return Result(blocked, std::move(to_preempt));
+    }
 
-            if (actor.Priority > e.OwnerPriority) {
-                to_preempt.push_back(e.Id);
-            } else {
-                return {false, "Higher priority booking exists", std::nullopt, {}};
-            }
+private:
+    static bool Visit(const TOccurrence& e, const TUser& actor, std::vector<BookingId>& to_preempt, bool& blocked) {
+        if (actor.Priority <= e.OwnerPriority) {
+            blocked = true;
+            return false;
+        }
+        if (std::find(to_preempt.begin(), to_preempt.end(), e.Id) == to_preempt.end()) {
+            to_preempt.push_back(e.Id);
         }
+        return true;
+    }
 
-        return {true, "Preempt allowed", std::nullopt, to_preempt};
+    static TConflictResolutionResult Result(bool blocked, std::vector<BookingId> to_preempt) {
+        if (blocked) {
+            return {false, "Higher priority booking exists", std::nullopt, {}};
+        }
+        return {true, "Preempt allowed", std::nullopt, std::move(to_preempt)};
     }
 };
 
@@ -84,19 +345,40 @@ struct TQuorumStrategy: public IConflictStrategy {
     explicit TQuorumStrategy(size_t quorum_size)
         : Quorum(quorum_size) {
     }
-    TConflictResolutionResult Resolve(const TBooking& candidate, const std::vector<TBooking>& existing, const TUser&) override {
-        for (auto const& e : existing) {
-            if (!(candidate.End <= e.Start || candidate.Start >= e.End)) {
-                if (candidate.Attendees.size() >= Quorum) {
-                    return {true, std::string("Allowed by quorum (") + std::to_string(Quorum) + ")", std::nullopt, {}};
-                }
 
-                return {false, std::string("Conflict and quorum not satisfied (need ") + std::to_string(Quorum) + ")", std::nullopt, {}};
-            }
+    const char* Name() const override {
+        return "quorum";
+    }
+
+    TConflictResolutionResult Resolve(const TBooking& candidate, const TOccurrenceSet& existing, const TUser&) override {
+        bool conflict = false;
+        existing.ForEachOverlap(candidate.Start, candidate.End, [&](const TOccurrence&) {
+            conflict = true;
+            return false;
+        });
+        return Result(conflict, candidate);
+    }
+
+    TConflictResolutionResult ResolveAll(const TBooking& request, std::span<const TOccurrence> instances, const TOccurrenceSet& existing, const TUser&) override {
+        bool conflict = false;
+        existing.SweepOverlaps(instances, [&](size_t, const TOccurrence&) {
+            conflict = true;
+            return false;
+        });
+        return Result(conflict, request);
+    }
+
+private:
+    TConflictResolutionResult Result(bool conflict, const TBooking& candidate) const {
+        if (!conflict) {
+            return {true, std::nullopt, std::nullopt, {}};
         }
-        return {true, std::nullopt, std::nullopt, {}};
+        if (candidate.Attendees.size() >= Quorum) {
+            return {true, std::string("Allowed by quorum (") + std::to_string(Quorum) + ")", std::nullopt, {}};
+        }
+        return {false, std::string("Conflict and quorum not satisfied (need ") + std::to_string(Quorum) + ")", std::nullopt, {}};
     }
 
 private:
     size_t Quorum;
-};
\ No newline at end of file
+};
@@ -0,0 +1,225 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+#include "Arena.hpp"
+#include "Strategy.hpp"
+
+// Composable conflict strategies. The overlap scan runs once per request;
+// every stage then looks at the same conflict list and either decides
+// (returns a result) or hands over to the next stage (returns nullopt).
+// When no stage decides the request is rejected.
+//
+//   TStrategyPipeline<TRequireQuorumStage, TPreemptStage>   // reject unless quorum, else preempt
+//
+// TStrategyPipeline is resolved at compile time; TStageChain holds the same
+// stages behind a virtual interface for configurations picked at runtime.
+// Both are IConflictStrategy, so either can be handed to SetStrategy.
+
+struct TStageContext {
+    const TBooking& Request;
+    std::span<const TOccurrence> Instances;
+    const TOccurrenceSet& Existing;
+    const TUser& Actor;
+    // Existing occurrences overlapping any requested instance, each booking
+    // once, in the order the sweep met them. Never empty.
+    std::span<const TOccurrence> Conflicts;
+};
+
+using TStageResult = std::optional<TConflictResolutionResult>;
+
+namespace NBooking::NPipeline {
+
+    // What the pipeline answers when no stage decides.
+    inline TConflictResolutionResult Undecided(std::span<const TOccurrence> conflicts) {
+        return {false, ConflictMessage(conflicts.front().Id), std::nullopt, {}};
+    }
+
+} // namespace NBooking::NPipeline
+
+// Rejects on any conflict.
+struct TRejectStage {
+    TStageResult Decide(const TStageContext& ctx) const {
+        return NBooking::NPipeline::Undecided(ctx.Conflicts);
+    }
+};
+
+// Accepts a conflicting request with at least Quorum attendees.
+struct TQuorumStage {
+    size_t Quorum = 0;
+
+    TStageResult Decide(const TStageContext& ctx) const {
+        if (ctx.Request.Attendees.size() >= Quorum) {
+            return TConflictResolutionResult{true, std::string("Allowed by quorum (") + std::to_string(Quorum) + ")", std::nullopt, {}};
+        }
+        return std::nullopt;
+    }
+};
+
+// Rejects a conflicting request with fewer than Quorum attendees.
+struct TRequireQuorumStage {
+    size_t Quorum = 0;
+
+    TStageResult Decide(const TStageContext& ctx) const {
+        if (ctx.Request.Attendees.size() < Quorum) {
+            return TConflictResolutionResult{false, std::string("Conflict and quorum not satisfied (need ") + std::to_string(Quorum) + ")", std::nullopt, {}};
+        }
+        return std::nullopt;
+    }
+};
+
+// Preempts when every conflict has a lower owner priority than the actor.
+struct TPreemptStage {
+    TStageResult Decide(const TStageContext& ctx) const {
+        std::vector<BookingId> ids;
+        ids.reserve(ctx.Conflicts.size());
+        for (auto const& c : ctx.Conflicts) {
+            if (ctx.Actor.Priority <= c.OwnerPriority) {
+                return std::nullopt;
+            }
+            ids.push_back(c.Id);
+        }
+        return TConflictResolutionResult{true, "Preempt allowed", std::nullopt, std::move(ids)};
+    }
+};
+
+// Moves a one-off request to the earliest gap within Horizon (if set).
+// Series are left to the next stage.
+struct TAutoBumpStage {
+    std::optional<std::chrono::system_clock::duration> Horizon;
+
+    TStageResult Decide(const TStageContext& ctx) const {
+        if (ctx.Instances.size() != 1) {
+            return std::nullopt;
+        }
+        auto const& inst = ctx.Instances.front();
+        auto start = ctx.Existing.EarliestFit(inst.Start, inst.End - inst.Start);
+        if (Horizon && start - inst.Start > *Horizon) {
+            return std::nullopt;
+        }
+        return TConflictResolutionResult{true, "Auto-bumped", start, {}};
+    }
+};
+
+namespace NBooking::NPipeline {
+
+    // The fused scan: one sweep over the requested instances, each
+    // conflicting booking recorded once, by its earliest occurrence and in
+    // id order. Lives in the request arena.
+    inline std::pmr::vector<TOccurrence> Conflicts(std::span<const TOccurrence> instances, const TOccurrenceSet& existing) {
+        std::pmr::vector<TOccurrence> out(TRequestArena::Resource());
+        existing.SweepOverlaps(instances, [&](size_t, const TOccurrence& e) {
+            out.push_back(e);
+            return true;
+        });
+        std::sort(out.begin(), out.end(), [](const TOccurrence& a, const TOccurrence& b) {
+            return std::tie(a.Id, a.Start) < std::tie(b.Id, b.Start);
+        });
+        auto last = std::unique(out.begin(), out.end(), [](const TOccurrence& a, const TOccurrence& b) {
+            return a.Id == b.Id;
+        });
+        out.erase(last, out.end());
+        return out;
+    }
+
+} // namespace NBooking::NPipeline
+
+template <class... TStages>
+class TStrategyPipeline: public IConflictStrategy {
+public:
+    explicit TStrategyPipeline(TStages... stages)
+        : Stages(std::move(stages)...) {
+    }
+
+    const char* Name() const override {
+        return "pipeline";
+    }
+
+    TConflictResolutionResult Resolve(const TBooking& candidate, const TOccurrenceSet& existing, const TUser& actor) override {
+        TOccurrence inst{candidate.Start, candidate.End, candidate.Id, candidate.OwnerPriority};
+        return ResolveAll(candidate, std::span<const TOccurrence>(&inst, 1), existing, actor);
+    }
+
+    TConflictResolutionResult ResolveAll(const TBooking& request,
+                                         std::span<const TOccurrence> instances,
+                                         const TOccurrenceSet& existing,
+                                         const TUser& actor) override {
+        NBooking::TRequestArena::TScope arena;
+        auto conflicts = NBooking::NPipeline::Conflicts(instances, existing);
+        if (conflicts.empty()) {
+            return {true, std::nullopt, std::nullopt, {}};
+        }
+        TStageContext ctx{request, instances, existing, actor, conflicts};
+        TStageResult res;
+        // Left to right, stopping at the first stage that decides.
+        std::apply([&](const auto&... stage) {
+            (void)((res = stage.Decide(ctx)) || ...);
+        }, Stages);
+        return res ? std::move(*res) : NBooking::NPipeline::Undecided(conflicts);
+    }
+
+private:
+    std::tuple<TStages...> Stages;
+};
+
+// Runtime-assembled counterpart of TStrategyPipeline.
+class TStageChain: public IConflictStrategy {
+public:
+    struct IStage {
+        virtual ~IStage() = default;
+        virtual TStageResult Decide(const TStageContext& ctx) const = 0;
+    };
+
+    template <class TStage>
+    struct TStageAdapter: public IStage {
+        explicit TStageAdapter(TStage stage)
+            : Stage(std::move(stage)) {
+        }
+
+        TStageResult Decide(const TStageContext& ctx) const override {
+            return Stage.Decide(ctx);
+        }
+
+        TStage Stage;
+    };
+
+    TStageChain() = default;
+
+    template <class TStage>
+    TStageChain& Then(TStage stage) {
+        Stages.push_back(std::make_unique<TStageAdapter<TStage>>(std::move(stage)));
+        return *this;
+    }
+
+    const char* Name() const override {
+        return "chain";
+    }
+
+    TConflictResolutionResult Resolve(const TBooking& candidate, const TOccurrenceSet& existing, const TUser& actor) override {
+        TOccurrence inst{candidate.Start, candidate.End, candidate.Id, candidate.OwnerPriority};
+        return ResolveAll(candidate, std::span<const TOccurrence>(&inst, 1), existing, actor);
+    }
+
+    TConflictResolutionResult ResolveAll(const TBooking& request,
+                                         std::span<const TOccurrence> instances,
+                                         const TOccurrenceSet& existing,
+                                         const TUser& actor) override {
+        NBooking::TRequestArena::TScope arena;
+        auto conflicts = NBooking::NPipeline::Conflicts(instances, existing);
+        if (conflicts.empty()) {
+            return {true, std::nullopt, std::nullopt, {}};
+        }
+        TStageContext ctx{request, instances, existing, actor, conflicts};
+        for (auto const& stage : Stages) {
+            if (auto res = stage->Decide(ctx)) {
+                return std::move(*res);
+            }
+        }
+        return NBooking::NPipeline::Undecided(conflicts);
+    }
+
+private:
+    std::vector<std::unique_ptr<IStage>> Stages;
+};
@@ -2,6 +2,8 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <iterator>
+#include <memory>
 #include <optional>
 #include <unordered_set>
 #include <nlohmann/json.hpp>
@@ -29,6 +31,11 @@ struct TResource {
     std::string Id; // e.g., "projector-1"
 };
 
+struct TRoom {
+    RoomId Id;
+    size_t Capacity = 0; // seats
+};
+
 struct TRecurrence {
     enum class Type {
         None,
@@ -38,6 +45,95 @@ struct TRecurrence {
     std::optional<std::chrono::system_clock::time_point> Until;
 };
 
+// Immutable value shared between copies; a write detaches it first. Copying
+// a booking bumps reference counts instead of copying strings and vectors.
+template <class T>
+class TShared {
+public:
+    TShared() = default;
+
+    TShared(T value)
+        : Ptr(std::make_shared<T>(std::move(value))) {
+    }
+
+    TShared& operator=(T value) {
+        Ptr = std::make_shared<T>(std::move(value));
+        return *this;
+    }
+
+    const T& get() const {
+        static const T empty{};
+        return Ptr ? *Ptr : empty;
+    }
+
+    operator const T&() const {
+        return get();
+    }
+
+    const T& operator*() const {
+        return get();
+    }
+
+    const T* operator->() const {
+        return &get();
+    }
+
+    // Copy-on-write access.
+    T& Mut() {
+        if (!Ptr) {
+            Ptr = std::make_shared<T>();
+        } else if (Ptr.use_count() > 1) {
+            Ptr = std::make_shared<T>(*Ptr);
+        }
+        return *Ptr;
+    }
+
+    // True when both refer to the same payload, not just equal ones.
+    bool SharesWith(const TShared& other) const {
+        return Ptr == other.Ptr;
+    }
+
+    size_t size() const {
+        return get().size();
+    }
+
+    bool empty() const {
+        return get().empty();
+    }
+
+    auto begin() const {
+        return get().begin();
+    }
+
+    auto end() const {
+        return get().end();
+    }
+
+    decltype(auto) operator[](size_t i) const {
+        return get()[i];
+    }
+
+    template <class U>
+    void push_back(U&& v) {
+        Mut().push_back(std::forward<U>(v));
+    }
+
+    void clear() {
+        Ptr.reset();
+    }
+
+    friend bool operator==(const TShared& a, const TShared& b) {
+        return a.Ptr == b.Ptr || a.get() == b.get();
+    }
+
+    friend bool operator==(const TShared& a, const T& b) {
+        return a.get() == b;
+    }
+
+private:
+    std::shared_ptr<T> Ptr;
+};
+
 struct TBooking {
     BookingId Id;
     RoomId RoomIdInternal;
@@ -45,10 +141,23 @@ struct TBooking {
     std::chrono::system_clock::time_point Start;
     std::chrono::system_clock::time_point End;
     TRecurrence Recurrence;
-    std::string Title;
-    std::string Description;
-    std::vector<UserId> Attendees;
-    std::vector<TResource> Resources;
+    // Payload, shared by every copy of the booking until one of them writes.
+    TShared<std::string> Title;
+    TShared<std::string> Description;
+    TShared<std::vector<UserId>> Attendees;
+    TShared<std::vector<TResource>> Resources;
+    int OwnerPriority = 0;
+    // Journal seq of the write that produced this state, set by the
+    // repository; not part of the encoded record.
+    uint64_t Version = 0;
+};
+
+// Single instance of a (possibly recurring) booking. Carries only what
+// conflict checks look at; the payload stays with the parent booking.
+struct TOccurrence {
+    std::chrono::system_clock::time_point Start;
+    std::chrono::system_clock::time_point End;
+    BookingId Id = 0;
     int OwnerPriority = 0;
 };
 
@@ -60,7 +169,7 @@ struct TCreateRequest {
 namespace NBooking {
 
     inline void ToJSON(json& j, TBooking const& b) {
-        j = json{{"id", b.Id}, {"room_id", b.RoomIdInternal}, {"user_id", b.UserIdInternal}, {"start", std::chrono::duration_cast<std::chrono::seconds>(b.Start.time_since_epoch()).count()}, {"end", std::chrono::duration_cast<std::chrono::seconds>(b.End.time_since_epoch()).count()}, {"title", b.Title}, {"description", b.Description}};
+        j = json{{"id", b.Id}, {"room_id", b.RoomIdInternal}, {"user_id", b.UserIdInternal}, {"start", std::chrono::duration_cast<std::chrono::seconds>(b.Start.time_since_epoch()).count()}, {"end", std::chrono::duration_cast<std::chrono::seconds>(b.End.time_since_epoch()).count()}, {"title", *b.Title}, {"description", *b.Description}};
     }
 
     inline void FromJsonInternal(json const& j, TBooking& b) {
@@ -71,11 +180,11 @@ namespace NBooking {
         auto e = j.at("end").get<long long>();
         b.Start = std::chrono::system_clock::time_point(std::chrono::seconds(s));
         b.End = std::chrono::system_clock::time_point(std::chrono::seconds(e));
-        if (j.contains("title")) {
-            b.Title = j.at("title").get<std::string>();
+        if (auto it = j.find("title"); it != j.end()) {
+            b.Title = it->get<std::string>();
         }
-        if (j.contains("description")) {
-            b.Description = j.at("description").get<std::string>();
+        if (auto it = j.find("description"); it != j.end()) {
+            b.Description = it->get<std::string>();
         }
     }
 
@@ -86,44 +195,141 @@ namespace NBooking {
         return !(a_end <= b_start || a_start >= b_end);
     }
 
-    inline std::vector<TBooking> GenerateInstances(const TBooking& b,
-                                                   const std::chrono::system_clock::time_point& from,
-                                                   const std::chrono::system_clock::time_point& to) {
-        std::vector<TBooking> out;
-        auto dur = b.End - b.Start;
-        if (b.Recurrence.type == TRecurrence::Type::None) {
-            if (IntervalsOverlap(b.Start, b.End, from, to)) {
-                out.push_back(b);
+    // Lazy view over the instances of b that overlap [from, to). The first
+    // instance is found arithmetically instead of stepping from b.Start.
+    class TOccurrenceRange {
+    public:
+        static constexpr size_t MAX_INSTANCES = 10000;
+
+        class TIterator {
+        public:
+            using value_type = TOccurrence;
+            using difference_type = std::ptrdiff_t;
+
+            TIterator() = default;
+
+            TIterator(const TOccurrenceRange* range, std::chrono::system_clock::time_point start)
+                : Range(range)
+                , Cur(start) {
             }
-            return out;
-        }
 
-        using namespace std::chrono;
-        system_clock::time_point cur_start = b.Start;
-        system_clock::time_point limit = to;
-        if (b.Recurrence.Until && *b.Recurrence.Until < limit) {
-            limit = *b.Recurrence.Until;
-        }
+            TOccurrence operator*() const {
+                return {Cur, Cur + Range->Duration, Range->Parent->Id, Range->Parent->OwnerPriority};
+            }
+
+            TIterator& operator++() {
+                ++Count;
+                if (Range->Step.count() == 0) {
+                    Range = nullptr;
+                } else {
+                    Cur += Range->Step;
+                }
+                return *this;
+            }
 
-        const size_t MAX_INSTANCES = 10000;
-        size_t counter = 0;
+            void operator++(int) {
+                ++*this;
+            }
 
-        while (cur_start < limit && counter < MAX_INSTANCES) {
-            auto cur_end = cur_start + dur;
-            if (IntervalsOverlap(cur_start, cur_end, from, to)) {
-                TBooking inst = b;
-                inst.Start = cur_start;
-                inst.End = cur_end;
-                out.push_back(std::move(inst));
+            bool operator==(std::default_sentinel_t) const {
+                return !Range || Cur >= Range->Limit || Count >= MAX_INSTANCES;
             }
+
+        private:
+            const TOccurrenceRange* Range = nullptr;
+            std::chrono::system_clock::time_point Cur;
+            size_t Count = 0;
+        };
+
+        TOccurrenceRange(const TBooking& b,
+                         std::chrono::system_clock::time_point from,
+                         std::chrono::system_clock::time_point to)
+            : Parent(&b)
+            , Duration(b.End - b.Start)
+            , First(b.Start)
+            , Limit(to) {
+            using namespace std::chrono;
             if (b.Recurrence.type == TRecurrence::Type::Daily) {
-                cur_start += hours(24);
+                Step = hours(24);
             } else if (b.Recurrence.type == TRecurrence::Type::Weekly) {
-                cur_start += hours(24 * 7);
-            } else {
-                break;
+                Step = hours(24 * 7);
+            }
+
+            if (Step.count() == 0) {
+                if (!IntervalsOverlap(b.Start, b.End, from, to)) {
+                    Limit = First;
+                }
+                return;
+            }
+
+            if (b.Recurrence.Until && *b.Recurrence.Until < Limit) {
+                Limit = *b.Recurrence.Until;
+            }
+            // first k with Start + k * Step + Duration > from
+            auto behind = from - Duration - b.Start;
+            if (behind >= system_clock::duration::zero()) {
+                First += (behind / Step + 1) * Step;
             }
-            ++counter;
+        }
+
+        TIterator begin() const {
+            return TIterator(this, First);
+        }
+
+        std::default_sentinel_t end() const {
+            return {};
+        }
+
+        bool empty() const {
+            return begin() == end();
+        }
+
+    private:
+        const TBooking* Parent;
+        std::chrono::system_clock::duration Duration;
+        std::chrono::system_clock::duration Step{0};
+        std::chrono::system_clock::time_point First;
+        std::chrono::system_clock::time_point Limit;
+    };
+
+    inline TOccurrenceRange Occurrences(const TBooking& b,
+                                        const std::chrono::system_clock::time_point& from,
+                                        const std::chrono::system_clock::time_point& to) {
+        return TOccurrenceRange(b, from, to);
+    }
+
+    // End of the last instance of b; empty for a series without Until.
+    inline std::optional<std::chrono::system_clock::time_point> LastEnd(const TBooking& b) {
+        using namespace std::chrono;
+        system_clock::duration step{0};
+        if (b.Recurrence.type == TRecurrence::Type::Daily) {
+            step = hours(24);
+        } else if (b.Recurrence.type == TRecurrence::Type::Weekly) {
+            step = hours(24 * 7);
+        }
+        if (step.count() == 0) {
+            return b.End;
+        }
+        if (!b.Recurrence.Until) {
+            return std::nullopt;
+        }
+        if (*b.Recurrence.Until <= b.Start) {
+            return b.End;
+        }
+        // last k with Start + k * step < Until
+        auto k = (*b.Recurrence.Until - b.Start - system_clock::duration(1)) / step;
+        return b.End + k * step;
+    }
+
+    inline std::vector<TBooking> GenerateInstances(const TBooking& b,
+                                                   const std::chrono::system_clock::time_point& from,
+                                                   const std::chrono::system_clock::time_point& to) {
+        std::vector<TBooking> out;
+        for (auto occ : Occurrences(b, from, to)) {
+            TBooking inst = b;
+            inst.Start = occ.Start;
+            inst.End = occ.End;
+            out.push_back(std::move(inst));
         }
         return out;
     }
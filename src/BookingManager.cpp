@@ -1,48 +1,160 @@
 #include <BookingManager.hpp>
+#include <Arena.hpp>
+#include <Metrics.hpp>
+#include <climits>
 #include <iostream>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
 
 namespace NBooking {
 
+    namespace {
+
+        // Span of time whose existing bookings can conflict with b.
+        std::pair<std::chrono::system_clock::time_point, std::chrono::system_clock::time_point>
+        ConflictWindow(const TBooking& b) {
+            using namespace std::chrono;
+            auto from = b.Start - hours(24);
+            auto to = b.Recurrence.Until
+                          ? (*b.Recurrence.Until + hours(1))
+                          : (b.Start + hours(24 * 365));
+            return {from, to};
+        }
+
+        std::pmr::vector<TOccurrence> RequestedInstances(const TBooking& b,
+                                                         std::chrono::system_clock::time_point from,
+                                                         std::chrono::system_clock::time_point to,
+                                                         std::pmr::memory_resource* mr = std::pmr::get_default_resource()) {
+            std::pmr::vector<TOccurrence> out(mr);
+            for (auto occ : Occurrences(b, from, to)) {
+                out.push_back(occ);
+            }
+            if (out.empty()) {
+                out.push_back({b.Start, b.End, b.Id, b.OwnerPriority});
+            }
+            return out;
+        }
+
+    } // namespace
+
     TBookingManager::TBookingManager(std::shared_ptr<IRepository> repo,
                                      std::shared_ptr<IStorage> storage,
-                                     std::shared_ptr<IConflictStrategy> strategy)
+                                     std::shared_ptr<IConflictStrategy> strategy,
+                                     THistoryOptions history)
         : Repo(std::move(repo))
         , Storage(std::move(storage))
-        , Strat(std::move(strategy)) {
+        , Strat(std::move(strategy))
+        , HistoryOptions(history) {
+    }
+
+    std::unique_lock<std::mutex> TBookingManager::LockHistory() {
+        return NMetrics::Timed(NMetrics::ETimer::HistoryLockWait, [this] {
+            return std::unique_lock(HistoryMutex_);
+        });
+    }
+
+    void TBookingManager::PushUndo(UserId user, std::unique_ptr<ICommand> cmd) {
+        auto lk = LockHistory();
+        auto& h = Histories[user];
+        for (auto const& old : h.RedoStack) {
+            h.Bytes -= old->Bytes();
+        }
+        h.RedoStack.clear();
+        h.Bytes += cmd->Bytes();
+        h.UndoStack.push_back(std::move(cmd));
+        TrimLocked(user);
     }
 
-    void TBookingManager::PushUndo(std::unique_ptr<ICommand> cmd) {
-        std::lock_guard lk(HistoryMutex_);
-        UndoStack.push_back(std::move(cmd));
-        if (UndoStack.size() > UNDO_LIMIT) {
-            UndoStack.pop_front();
+    void TBookingManager::TrimLocked(UserId user) {
+        auto& h = Histories[user];
+        while (!h.UndoStack.empty() &&
+               (h.UndoStack.size() > HistoryOptions.StepsPerUser || h.Bytes > HistoryOptions.BytesPerUser)) {
+            h.Bytes -= h.UndoStack.front()->Bytes();
+            h.UndoStack.pop_front();
         }
-        RedoStack.clear();
+        EraseIfEmptyLocked(user);
+    }
+
+    void TBookingManager::EraseIfEmptyLocked(UserId user) {
+        auto it = Histories.find(user);
+        if (it != Histories.end() && it->second.UndoStack.empty() && it->second.RedoStack.empty()) {
+            Histories.erase(it);
+        }
+    }
+
+    size_t TBookingManager::HistoryUsers() {
+        auto lk = LockHistory();
+        return Histories.size();
     }
 
-    std::optional<std::string> TBookingManager::Undo() {
-        std::unique_lock lk(HistoryMutex_);
-        if (UndoStack.empty()) {
-            return std::nullopt;
+    // The command is taken off the stack under HistoryMutex_ and replayed
+    // without it, so one user's repository I/O never blocks other histories.
+    std::optional<std::string> TBookingManager::Undo(const TUser& actor) {
+        NMetrics::TScope timer(NMetrics::ETimer::Undo);
+        std::unique_ptr<ICommand> cmd;
+        {
+            auto lk = LockHistory();
+            auto it = Histories.find(actor.Id);
+            if (it == Histories.end() || it->second.UndoStack.empty()) {
+                return std::nullopt;
+            }
+            cmd = std::move(it->second.UndoStack.back());
+            it->second.UndoStack.pop_back();
+            it->second.Bytes -= cmd->Bytes();
+            EraseIfEmptyLocked(actor.Id);
         }
-        auto cmd = std::move(UndoStack.back());
-        UndoStack.pop_back();
         std::string desc = cmd->Describe();
-        cmd->Undo();
-        RedoStack.push_back(std::move(cmd));
+        try {
+            cmd->Undo();
+        } catch (...) {
+            auto lk = LockHistory();
+            auto& h = Histories[actor.Id];
+            h.Bytes += cmd->Bytes();
+            h.UndoStack.push_back(std::move(cmd));
+            throw;
+        }
+        {
+            auto lk = LockHistory();
+            auto& h = Histories[actor.Id];
+            h.Bytes += cmd->Bytes();
+            h.RedoStack.push_back(std::move(cmd));
+        }
         return std::optional<std::string>(std::string("Undid: ") + desc);
     }
 
-    std::optional<std::string> TBookingManager::Redo() {
-        std::unique_lock lk(HistoryMutex_);
-        if (RedoStack.empty()) {
-            return std::nullopt;
+    std::optional<std::string> TBookingManager::Redo(const TUser& actor) {
+        NMetrics::TScope timer(NMetrics::ETimer::Redo);
+        std::unique_ptr<ICommand> cmd;
+        {
+            auto lk = LockHistory();
+            auto it = Histories.find(actor.Id);
+            if (it == Histories.end() || it->second.RedoStack.empty()) {
+                return std::nullopt;
+            }
+            cmd = std::move(it->second.RedoStack.back());
+            it->second.RedoStack.pop_back();
+            it->second.Bytes -= cmd->Bytes();
+            EraseIfEmptyLocked(actor.Id);
         }
-        auto cmd = std::move(RedoStack.back());
-        RedoStack.pop_back();
         std::string desc = cmd->Describe();
-        cmd->Execute();
-        UndoStack.push_back(std::move(cmd));
+        try {
+            cmd->Execute();
+        } catch (...) {
+            auto lk = LockHistory();
+            auto& h = Histories[actor.Id];
+            h.Bytes += cmd->Bytes();
+            h.RedoStack.push_back(std::move(cmd));
+            throw;
+        }
+        {
+            auto lk = LockHistory();
+            auto& h = Histories[actor.Id];
+            h.Bytes += cmd->Bytes();
+            h.UndoStack.push_back(std::move(cmd));
+            TrimLocked(actor.Id);
+        }
         return std::optional<std::string>(std::string("Redid: ") + desc);
     }
 
@@ -53,15 +165,90 @@ namespace NBooking {
     std::vector<TBooking> TBookingManager::ListBookings(RoomId room,
                                                         std::chrono::system_clock::time_point from,
                                                         std::chrono::system_clock::time_point to) {
-        std::vector<TBooking> out;
-        auto all = Repo->ListAll();
-        for (auto& b : all) {
-            if (b.RoomIdInternal != room) {
-                continue;
+        NMetrics::TScope timer(NMetrics::ETimer::List);
+        return Lists.Get(room, from, to, [&](auto wf, auto wt) {
+            std::vector<TBooking> out;
+            for (auto& b : Repo->ListInRange(room, wf, wt)) {
+                auto inst = GenerateInstances(b, wf, wt);
+                out.insert(out.end(), inst.begin(), inst.end());
+            }
+            return out;
+        });
+    }
+
+    void TBookingManager::VisitBookings(RoomId room,
+                                        std::chrono::system_clock::time_point from,
+                                        std::chrono::system_clock::time_point to,
+                                        const std::function<bool(const TBooking&)>& f) {
+        NMetrics::TScope timer(NMetrics::ETimer::List);
+        for (auto& b : Repo->ListInRange(room, from, to)) {
+            TBooking inst = b;
+            for (auto occ : Occurrences(b, from, to)) {
+                inst.Start = occ.Start;
+                inst.End = occ.End;
+                if (!f(inst)) {
+                    return;
+                }
             }
+        }
+    }
+
+    size_t TBookingManager::Archive(std::chrono::system_clock::time_point horizon) {
+        auto res = Repo->Archive(horizon);
+        Lists.Invalidate(res.Rooms);
+        return res.Ids.size();
+    }
+
+    std::vector<TBooking> TBookingManager::ListHistory(RoomId room,
+                                                       std::chrono::system_clock::time_point from,
+                                                       std::chrono::system_clock::time_point to) {
+        std::vector<TBooking> out;
+        for (auto& b : Repo->ListArchived(room, from, to)) {
             auto inst = GenerateInstances(b, from, to);
             out.insert(out.end(), inst.begin(), inst.end());
         }
+        auto active = ListBookings(room, from, to);
+        out.insert(out.end(), std::make_move_iterator(active.begin()), std::make_move_iterator(active.end()));
+        return out;
+    }
+
+    std::vector<TFreeSlot> TBookingManager::FreeSlots(RoomId room,
+                                                      std::chrono::system_clock::time_point from,
+                                                      std::chrono::system_clock::time_point to,
+                                                      const std::vector<TResource>& resources) {
+        auto busy = Repo->RoomOccurrences(room, from, to);
+        if (!resources.empty()) {
+            auto held = Repo->ResourceOccurrences(resources, from, to);
+            busy.insert(busy.end(), held.begin(), held.end());
+        }
+        return FreeIntervals(room, TOccurrenceSet(std::move(busy)), from, to);
+    }
+
+    std::vector<TFreeSlot> TBookingManager::FindAvailable(const TAvailabilityQuery& q) {
+        std::vector<TFreeSlot> out;
+        if (q.Limit == 0 || q.To - q.From < q.Length) {
+            return out;
+        }
+        // Resource usage is the same for every candidate room, fetch it once.
+        std::vector<TOccurrence> held;
+        if (!q.Resources.empty()) {
+            held = Repo->ResourceOccurrences(q.Resources, q.From, q.To);
+        }
+        for (auto const& room : q.Rooms) {
+            if (room.Capacity < q.Attendees) {
+                continue;
+            }
+            auto busy = Repo->RoomOccurrences(room.Id, q.From, q.To);
+            busy.insert(busy.end(), held.begin(), held.end());
+            auto start = TOccurrenceSet(std::move(busy)).EarliestFit(q.From, q.Length);
+            if (start + q.Length > q.To) {
+                continue;
+            }
+            out.push_back({room.Id, start, start + q.Length});
+            if (out.size() >= q.Limit) {
+                break;
+            }
+        }
         return out;
     }
 
@@ -97,130 +284,424 @@ namespace NBooking {
         return false;
     }
 
+    // On a versioned repository the check holds the stripes only shared and
+    // commits only if nothing in its room or resources was written since it
+    // read them; otherwise it is redone. Every lost race means another write
+    // committed, so the system as a whole always makes progress; after
+    // OPTIMISTIC_ATTEMPTS losses the stripes are taken exclusively, which
+    // shuts out other creates and cancels, so a hot room queues its creates
+    // instead of spinning them. The commit is still checked then: writers
+    // that take no stripes can still get in between.
     std::optional<BookingId> TBookingManager::CreateBooking(const TBooking& req, const TUser& actor) {
         if (!CanCreate(actor)) {
             throw std::runtime_error("Access denied: create");
         }
 
-        std::lock_guard lk(Mutex_);
-
-        using namespace std::chrono;
-
-        auto from = req.Start - hours(24);
-        auto to = req.Recurrence.Until
-                      ? (*req.Recurrence.Until + hours(1))
-                      : (req.Start + hours(24 * 365));
+        NMetrics::TScope timer(NMetrics::ETimer::Create);
+        // Everything that does not outlive the call (stripe list, instances,
+        // the existing set) lives in the thread's request arena.
+        TRequestArena::TScope arena;
+        auto* mr = TRequestArena::Resource();
+        bool optimistic = Repo->Versioned();
+        // Emplaced, not assigned: move assignment would copy the arena stripe
+        // list into the heap-backed list of the target guard.
+        std::optional<TLockStripes::TGuard> lk;
+        auto lock = [&](bool shared) {
+            lk.reset();
+            lk.emplace(NMetrics::Timed(NMetrics::ETimer::LockWait, [&] {
+                auto stripes = Stripes.ForBooking(req.RoomIdInternal, req.Resources, mr);
+                return shared ? Stripes.LockShared(std::move(stripes)) : Stripes.Lock(std::move(stripes));
+            }));
+        };
+        lock(optimistic);
+        auto strat = Strategy();
+
+        auto [from, to] = ConflictWindow(req);
 
         TBooking req_copy = req;
         req_copy.OwnerPriority = actor.Priority;
 
-        auto requestedInst = GenerateInstances(req_copy, from, to);
+        auto requestedInst = NMetrics::Timed(NMetrics::ETimer::Instances, [&] {
+            return RequestedInstances(req_copy, from, to, mr);
+        });
 
-        if (requestedInst.empty()) {
-            requestedInst.push_back(req_copy);
-        }
+        TVersionCheck check{{req_copy.RoomIdInternal}, req_copy.Resources, 0};
+        for (size_t attempt = 0;; ++attempt) {
+            if (optimistic && attempt == OPTIMISTIC_ATTEMPTS) {
+                // Undo, redo and archive take no stripes, so this still
+                // commits only through the version check.
+                lock(false);
+            }
+            if (optimistic) {
+                check.Version = Repo->ScopeVersion(check.Rooms, check.Resources);
+            }
+
+            NMetrics::TScope load(NMetrics::ETimer::Load);
+            std::pmr::vector<TOccurrence> existingInst(mr);
+            Repo->AppendRoomOccurrences(req_copy.RoomIdInternal, from, to, existingInst);
 
-        std::vector<TBooking> existingInst;
-        for (auto& ex : Repo->ListAll()) {
-            bool related = (ex.RoomIdInternal == req_copy.RoomIdInternal);
-            if (!related) {
-                for (auto& r : ex.Resources) {
-                    for (auto& rr : req_copy.Resources) {
-                        if (r.Id == rr.Id) {
-                            related = true;
+            // Bookings in other rooms are only related through shared resources.
+            if (!req_copy.Resources.empty()) {
+                for (auto& ex : Repo->ListByResources(req_copy.Resources, from, to)) {
+                    if (ex.RoomIdInternal != req_copy.RoomIdInternal) {
+                        for (auto occ : Occurrences(ex, from, to)) {
+                            existingInst.push_back(occ);
                         }
                     }
                 }
             }
-            if (!related) {
+
+            load.Stop();
+
+            // Every requested instance is checked in one sweep before anything is
+            // changed, so a rejection never leaves partial preemptions behind.
+            TOccurrenceSet existing(std::move(existingInst));
+            auto res = NMetrics::Timed(NMetrics::ETimer::Resolve, [&] {
+                return strat->ResolveAll(req_copy, requestedInst, existing, actor);
+            });
+            bool mayPreempt = actor.Role == ERole::Admin || actor.Role == ERole::Manager;
+            if (!res.ok || (!res.ToPreempt.empty() && !mayPreempt)) {
+                // A rejection stands only if what it was based on is still current.
+                if (optimistic && Repo->ScopeVersion(check.Rooms, check.Resources) != check.Version) {
+                    NMetrics::Add(NMetrics::ECounter::VersionConflicts);
+                    continue;
+                }
+                NMetrics::Add(NMetrics::ECounter::Rejected);
+                if (!res.ok) {
+                    NMetrics::Reject(strat->Name());
+                }
+                return std::nullopt;
+            }
+
+            TBooking b = req_copy;
+            if (res.SuggestedStart) {
+                auto dur = b.End - b.Start;
+                b.Start = *res.SuggestedStart;
+                b.End = b.Start + dur;
+            }
+
+            // Preemptions and the create are one commit and one undo step.
+            NMetrics::TScope persist(NMetrics::ETimer::Persist);
+            auto commit = [&](auto& cmd) {
+                if (!optimistic) {
+                    cmd->Execute();
+                    return true;
+                }
+                return cmd->ExecuteIf(check);
+            };
+            std::unique_ptr<ICommand> done;
+            BookingId id = 0;
+            if (res.ToPreempt.empty()) {
+                auto cmd = std::make_unique<TCreateBookingCommand>(*Repo, std::move(b), &Lists);
+                if (commit(cmd)) {
+                    id = cmd->id();
+                    done = std::move(cmd);
+                }
+            } else {
+                std::vector<TBooking> pending;
+                pending.push_back(std::move(b));
+                auto cmd = std::make_unique<TBatchCreateCommand>(*Repo, std::move(pending), res.ToPreempt, &Lists);
+                if (commit(cmd)) {
+                    id = cmd->ids().front();
+                    done = std::move(cmd);
+                }
+            }
+            if (!done) {
+                NMetrics::Add(NMetrics::ECounter::VersionConflicts);
                 continue;
             }
+            persist.Stop();
 
-            auto insts = GenerateInstances(ex, from, to);
-            existingInst.insert(existingInst.end(), insts.begin(), insts.end());
+            NMetrics::Add(NMetrics::ECounter::Created);
+            NMetrics::Add(NMetrics::ECounter::Preempted, res.ToPreempt.size());
+            if (res.SuggestedStart) {
+                NMetrics::Add(NMetrics::ECounter::AutoBumped);
+            }
+            PushUndo(actor.Id, std::move(done));
+            return id;
         }
+    }
 
-        for (auto& inst : requestedInst) {
-            auto res = Strat->Resolve(inst, existingInst, actor);
-            if (!res.ok) {
-                return std::nullopt;
+    std::optional<BookingId> TBookingManager::CreateBooking(const TCreateRequest& req) {
+        return CreateBooking(req.Booking, req.Actor);
+    }
+
+    // Optimistic like CreateBooking, with the batch's rooms and resources as
+    // the checked scope; a lost race redoes the whole batch.
+    std::vector<TBatchItemResult> TBookingManager::CreateBookings(std::span<const TCreateRequest> reqs) {
+        using std::chrono::system_clock;
+
+        std::vector<TBatchItemResult> results(reqs.size());
+        if (reqs.empty()) {
+            return results;
+        }
+
+        // The merged stripe list and the guards' copies of it live in the
+        // thread's request arena, as in CreateBooking.
+        TRequestArena::TScope arena;
+        auto* mr = TRequestArena::Resource();
+        std::pmr::vector<size_t> stripes(mr);
+        auto from = system_clock::time_point::max();
+        auto to = system_clock::time_point::min();
+        TVersionCheck check;
+        for (auto const& r : reqs) {
+            auto s = Stripes.ForBooking(r.Booking.RoomIdInternal, r.Booking.Resources, mr);
+            stripes.insert(stripes.end(), s.begin(), s.end());
+            auto [f, t] = ConflictWindow(r.Booking);
+            from = std::min(from, f);
+            to = std::max(to, t);
+            check.Rooms.push_back(r.Booking.RoomIdInternal);
+            check.Resources.insert(check.Resources.end(), r.Booking.Resources.begin(), r.Booking.Resources.end());
+        }
+        std::sort(check.Rooms.begin(), check.Rooms.end());
+        check.Rooms.erase(std::unique(check.Rooms.begin(), check.Rooms.end()), check.Rooms.end());
+        auto const& resources = check.Resources;
+
+        NMetrics::TScope timer(NMetrics::ETimer::CreateBatch);
+        bool optimistic = Repo->Versioned();
+        std::optional<TLockStripes::TGuard> lk;
+        auto lock = [&](bool shared) {
+            lk.reset();
+            lk.emplace(NMetrics::Timed(NMetrics::ETimer::LockWait, [&] {
+                // A plain copy would take the default resource.
+                std::pmr::vector<size_t> copy(stripes, mr);
+                return shared ? Stripes.LockShared(std::move(copy)) : Stripes.Lock(std::move(copy));
+            }));
+        };
+        lock(optimistic);
+        auto strat = Strategy();
+
+        // Grouped by room and ordered by start so each room is swept forward.
+        std::vector<size_t> order(reqs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            auto const& x = reqs[a].Booking;
+            auto const& y = reqs[b].Booking;
+            return std::tie(x.RoomIdInternal, x.Start) < std::tie(y.RoomIdInternal, y.Start);
+        });
+
+        for (size_t attempt = 0;; ++attempt) {
+            if (optimistic && attempt == OPTIMISTIC_ATTEMPTS) {
+                // Still checked, as in CreateBooking.
+                lock(false);
             }
+            if (optimistic) {
+                check.Version = Repo->ScopeVersion(check.Rooms, check.Resources);
+            }
+            results.assign(reqs.size(), {});
+
+            // Working set, loaded once: occurrences per room and, per resource,
+            // the occurrences holding it together with their room. Accepted batch
+            // items join it under BATCH_ITEM | index and a priority no one can
+            // preempt, so a conflict with one names that item.
+            std::unordered_map<RoomId, TOccurrenceSet> byRoom;
+            std::unordered_map<std::string, std::vector<std::pair<RoomId, TOccurrence>>> byResource;
+            auto addToResources = [&](const TBooking& b, const TOccurrence& occ) {
+                for (auto const& res : b.Resources) {
+                    byResource[res.Id].emplace_back(b.RoomIdInternal, occ);
+                }
+            };
+
+            // Items holding resources are checked against their room merged
+            // with the other rooms' holders of those resources: one set per
+            // (room, resources), built on first use and grown with the batch.
+            using TMergedKey = std::pair<RoomId, std::vector<std::string>>;
+            std::map<TMergedKey, TOccurrenceSet> merged;
+            auto mergedFor = [&](TMergedKey key) -> TOccurrenceSet& {
+                auto [it, inserted] = merged.try_emplace(std::move(key));
+                if (inserted) {
+                    RoomId room = it->first.first;
+                    auto const& roomSet = byRoom[room];
+                    std::vector<TOccurrence> all(roomSet.Items().begin(), roomSet.Items().end());
+                    for (auto const& res : it->first.second) {
+                        for (auto const& [r, occ] : byResource[res]) {
+                            if (r != room) {
+                                all.push_back(occ);
+                            }
+                        }
+                    }
+                    it->second = TOccurrenceSet(std::move(all));
+                }
+                return it->second;
+            };
 
-            if (!res.ToPreempt.empty()) {
-                if (actor.Role != ERole::Admin && actor.Role != ERole::Manager) {
-                    return std::nullopt;
+            for (RoomId room : check.Rooms) {
+                byRoom.emplace(room, TOccurrenceSet(Repo->RoomOccurrences(room, from, to)));
+            }
+            if (!resources.empty()) {
+                for (auto const& ex : Repo->ListByResources(resources, from, to)) {
+                    for (auto o : Occurrences(ex, from, to)) {
+                        addToResources(ex, o);
+                    }
                 }
+            }
 
-                for (BookingId bid : res.ToPreempt) {
-                    auto old = Repo->GetBooking(bid);
-                    if (!old) {
-                        continue;
+            // Counted once the outcome is committed, not per attempt.
+            size_t rejected = 0;
+            size_t bumped = 0;
+            std::vector<const char*> rejectedBy;
+            std::vector<TBooking> accepted;
+            std::vector<size_t> acceptedIdx;
+            std::vector<BookingId> preempt;
+            for (size_t i : order) {
+                auto const& actor = reqs[i].Actor;
+                if (!CanCreate(actor)) {
+                    results[i].Message = "Access denied: create";
+                    ++rejected;
+                    continue;
+                }
+
+                TBooking b = reqs[i].Booking;
+                b.OwnerPriority = actor.Priority;
+                auto [bf, bt] = ConflictWindow(b);
+                auto inst = RequestedInstances(b, bf, bt);
+
+                auto& roomSet = byRoom[b.RoomIdInternal];
+                const TOccurrenceSet* existing = &roomSet;
+                std::vector<std::string> held;
+                if (!b.Resources.empty()) {
+                    for (auto const& r : b.Resources) {
+                        held.push_back(r.Id);
                     }
+                    std::sort(held.begin(), held.end());
+                    held.erase(std::unique(held.begin(), held.end()), held.end());
+                    existing = &mergedFor({b.RoomIdInternal, held});
+                }
 
-                    auto rm = std::make_unique<TRemoveBookingCommand>(*Repo, bid);
-                    rm->Execute();
+                auto res = NMetrics::Timed(NMetrics::ETimer::Resolve, [&] {
+                    return strat->ResolveAll(b, inst, *existing, actor);
+                });
+                results[i].Message = res.Message;
+                if (!res.ok) {
+                    ++rejected;
+                    rejectedBy.push_back(strat->Name());
+                    continue;
+                }
 
-                    if (Repo->GetBooking(bid)) {
-                        Repo->RemoveBooking(bid);
+                if (!res.ToPreempt.empty()) {
+                    if (actor.Role != ERole::Admin && actor.Role != ERole::Manager) {
+                        results[i].Message = "Access denied: preempt";
+                        ++rejected;
+                        continue;
+                    }
+                    for (BookingId bid : res.ToPreempt) {
+                        if (std::find(preempt.begin(), preempt.end(), bid) == preempt.end()) {
+                            preempt.push_back(bid);
+                        }
+                    }
+                    for (auto& [room, set] : byRoom) {
+                        set.Erase(res.ToPreempt);
+                    }
+                    for (auto& [key, set] : merged) {
+                        set.Erase(res.ToPreempt);
+                    }
+                    for (auto& [id, held] : byResource) {
+                        std::erase_if(held, [&](const std::pair<RoomId, TOccurrence>& h) {
+                            return std::find(res.ToPreempt.begin(), res.ToPreempt.end(), h.second.Id) != res.ToPreempt.end();
+                        });
                     }
+                }
 
-                    PushUndo(std::move(rm));
+                if (res.SuggestedStart) {
+                    ++bumped;
+                    auto dur = b.End - b.Start;
+                    b.Start = *res.SuggestedStart;
+                    b.End = b.Start + dur;
                 }
 
-                existingInst.erase(
-                    std::remove_if(existingInst.begin(), existingInst.end(),
-                                   [&](const TBooking& b) {
-                                       return std::find(res.ToPreempt.begin(),
-                                                        res.ToPreempt.end(),
-                                                        b.Id) != res.ToPreempt.end();
-                                   }),
-                    existingInst.end());
+                // Merged sets of this room, or of another room sharing a resource.
+                std::vector<TOccurrenceSet*> touched;
+                for (auto& [key, set] : merged) {
+                    bool shares = key.first != b.RoomIdInternal && std::any_of(held.begin(), held.end(), [&](const std::string& r) {
+                        return std::binary_search(key.second.begin(), key.second.end(), r);
+                    });
+                    if (key.first == b.RoomIdInternal || shares) {
+                        touched.push_back(&set);
+                    }
+                }
+                for (auto o : Occurrences(b, from, to)) {
+                    o.Id = BATCH_ITEM | i;
+                    o.OwnerPriority = INT_MAX;
+                    roomSet.Insert(o);
+                    addToResources(b, o);
+                    for (auto* set : touched) {
+                        set->Insert(o);
+                    }
+                }
+                accepted.push_back(std::move(b));
+                acceptedIdx.push_back(i);
             }
 
-            if (res.SuggestedStart) {
-                TBooking adjusted = req_copy;
-                auto dur = adjusted.End - adjusted.Start;
-                adjusted.Start = *res.SuggestedStart;
-                adjusted.End = adjusted.Start + dur;
+            auto count = [&] {
+                NMetrics::Add(NMetrics::ECounter::Rejected, rejected);
+                for (auto name : rejectedBy) {
+                    NMetrics::Reject(name);
+                }
+                NMetrics::Add(NMetrics::ECounter::AutoBumped, bumped);
+            };
 
-                auto cmd = std::make_unique<TCreateBookingCommand>(*Repo, adjusted);
+            if (accepted.empty() && preempt.empty()) {
+                if (optimistic && Repo->ScopeVersion(check.Rooms, check.Resources) != check.Version) {
+                    NMetrics::Add(NMetrics::ECounter::VersionConflicts);
+                    continue;
+                }
+                count();
+                return results;
+            }
+
+            NMetrics::TScope persist(NMetrics::ETimer::Persist);
+            size_t created = accepted.size();
+            size_t preempted = preempt.size();
+            auto cmd = std::make_unique<TBatchCreateCommand>(*Repo, std::move(accepted), std::move(preempt), &Lists);
+            if (!optimistic) {
                 cmd->Execute();
-                auto id = cmd->id();
-                PushUndo(std::move(cmd));
-                return id;
+            } else if (!cmd->ExecuteIf(check)) {
+                NMetrics::Add(NMetrics::ECounter::VersionConflicts);
+                continue;
+            }
+            persist.Stop();
+            count();
+            NMetrics::Add(NMetrics::ECounter::Created, created);
+            NMetrics::Add(NMetrics::ECounter::Preempted, preempted);
+            for (size_t k = 0; k < acceptedIdx.size(); ++k) {
+                results[acceptedIdx[k]].Id = cmd->ids()[k];
             }
+            PushUndo(reqs.front().Actor.Id, std::move(cmd));
+            return results;
         }
-
-        auto cmd = std::make_unique<TCreateBookingCommand>(*Repo, req_copy);
-        cmd->Execute();
-        auto id = cmd->id();
-        PushUndo(std::move(cmd));
-        return id;
-    }
-
-    std::optional<BookingId> TBookingManager::CreateBooking(const TCreateRequest& req) {
-        return CreateBooking(req.Booking, req.Actor);
     }
 
     bool TBookingManager::CancelBooking(BookingId id, const TUser& actor) {
-        std::lock_guard lk(Mutex_);
+        NMetrics::TScope timer(NMetrics::ETimer::Cancel);
         auto ob = Repo->GetBooking(id);
         if (!ob) {
             return false;
         }
+        auto lk = NMetrics::Timed(NMetrics::ETimer::LockWait, [&] {
+            return Stripes.Lock(Stripes.ForBooking(ob->RoomIdInternal, ob->Resources));
+        });
+        ob = Repo->GetBooking(id);
+        if (!ob) {
+            return false;
+        }
         if (!CanCancel(actor, *ob)) {
             throw std::runtime_error("Access denied: cancel");
         }
 
-        auto cmd = std::make_unique<TRemoveBookingCommand>(*Repo, id);
+        auto cmd = std::make_unique<TRemoveBookingCommand>(*Repo, id, &Lists);
         cmd->Execute();
-        PushUndo(std::move(cmd));
+        PushUndo(actor.Id, std::move(cmd));
         return true;
     }
 
     void TBookingManager::SetStrategy(std::shared_ptr<IConflictStrategy> s) {
-        std::lock_guard lk(Mutex_);
-        Strat = s;
+        std::lock_guard lk(StratMutex_);
+        Strat = std::move(s);
+    }
+
+    std::shared_ptr<IConflictStrategy> TBookingManager::Strategy() {
+        std::lock_guard lk(StratMutex_);
+        return Strat;
     }
 
 } // namespace NBooking
@@ -0,0 +1,190 @@
+#include <BookingService.hpp>
+
+namespace NBooking {
+
+    TBookingService::TBookingService(TBookingManager& mgr, size_t workers)
+        : Mgr(mgr)
+        , Stripes(ROOM_STRIPES)
+        , Queues(std::max<size_t>(workers, 1)) {
+        Workers.reserve(Queues.size());
+        for (size_t i = 0; i < Queues.size(); ++i) {
+            Workers.emplace_back([this, i] {
+                WorkerLoop(i);
+            });
+        }
+    }
+
+    TBookingService::~TBookingService() {
+        Shutdown();
+    }
+
+    std::future<std::optional<BookingId>> TBookingService::CreateBooking(TBooking req, TUser actor) {
+        RoomId room = req.RoomIdInternal;
+        return Submit<std::optional<BookingId>>(room, [this, req = std::move(req), actor = std::move(actor)] {
+            return Mgr.CreateBooking(req, actor);
+        });
+    }
+
+    std::future<bool> TBookingService::CancelBooking(BookingId id, TUser actor) {
+        // Routed to the booking's room so it queues behind that room's creates;
+        // unknown ids still go through the manager for the usual answer.
+        auto b = Mgr.GetBooking(id);
+        RoomId room = b ? b->RoomIdInternal : 0;
+        return Submit<bool>(room, [this, id, actor = std::move(actor)] {
+            return Mgr.CancelBooking(id, actor);
+        });
+    }
+
+    std::future<std::vector<TBooking>> TBookingService::ListBookings(RoomId room,
+                                                                     std::chrono::system_clock::time_point from,
+                                                                     std::chrono::system_clock::time_point to) {
+        return Submit<std::vector<TBooking>>(room, [this, room, from, to] {
+            return Mgr.ListBookings(room, from, to);
+        });
+    }
+
+    void TBookingService::Shutdown() {
+        std::lock_guard guard(ShutdownMutex_);
+        if (Stopping.exchange(true)) {
+            return;
+        }
+        {
+            // Workers check Stopping under IdleMutex_ before they sleep.
+            std::lock_guard lk(IdleMutex_);
+        }
+        Cv.notify_all();
+        for (auto& w : Workers) {
+            w.join();
+        }
+        Workers.clear();
+    }
+
+    void TBookingService::Enqueue(RoomId room, TTask task) {
+        Submitting.fetch_add(1);
+        if (Stopping.load()) {
+            Submitting.fetch_sub(1);
+            throw std::runtime_error("TBookingService: shut down");
+        }
+        bool ready = false;
+        {
+            auto& stripe = StripeOf(room);
+            std::lock_guard lk(stripe.Mutex_);
+            auto& q = stripe.Rooms[room];
+            q.Tasks.push_back(std::move(task));
+            if (!q.Scheduled) {
+                q.Scheduled = true;
+                ready = true;
+            }
+        }
+        if (ready) {
+            PushReady(std::hash<RoomId>{}(room) % Queues.size(), room);
+        }
+        Submitting.fetch_sub(1);
+    }
+
+    void TBookingService::PushReady(size_t worker, RoomId room) {
+        {
+            auto& q = Queues[worker];
+            std::lock_guard lk(q.Mutex_);
+            q.Ready.push_back(room);
+        }
+        // A worker going idle bumps Idle and then looks at the queues once
+        // more under IdleMutex_, so either it sees this room or we see it.
+        if (Idle.load() > 0) {
+            std::lock_guard lk(IdleMutex_);
+            Cv.notify_one();
+        }
+    }
+
+    // Own queue from the front, otherwise steal from the back of another.
+    bool TBookingService::PopReady(size_t worker, RoomId& room) {
+        {
+            auto& own = Queues[worker];
+            std::lock_guard lk(own.Mutex_);
+            if (!own.Ready.empty()) {
+                room = own.Ready.front();
+                own.Ready.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < Queues.size(); ++k) {
+            auto& victim = Queues[(worker + k) % Queues.size()];
+            std::lock_guard lk(victim.Mutex_);
+            if (!victim.Ready.empty()) {
+                room = victim.Ready.back();
+                victim.Ready.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool TBookingService::AnyReady() {
+        for (auto& q : Queues) {
+            std::lock_guard lk(q.Mutex_);
+            if (!q.Ready.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool TBookingService::WaitForWork() {
+        std::unique_lock lk(IdleMutex_);
+        Idle.fetch_add(1);
+        if (AnyReady()) {
+            Idle.fetch_sub(1);
+            return true;
+        }
+        if (Stopping.load() && Submitting.load() == 0) {
+            Idle.fetch_sub(1);
+            return false;
+        }
+        Cv.wait_for(lk, IDLE_WAIT);
+        Idle.fetch_sub(1);
+        return true;
+    }
+
+    void TBookingService::WorkerLoop(size_t worker) {
+        while (true) {
+            RoomId room = 0;
+            if (!PopReady(worker, room)) {
+                if (!WaitForWork()) {
+                    return;
+                }
+                continue;
+            }
+
+            // The room stays Scheduled while drained, so nobody else takes it.
+            auto& stripe = StripeOf(room);
+            for (size_t n = 0; n < ROOM_BATCH; ++n) {
+                TTask task;
+                {
+                    std::lock_guard lk(stripe.Mutex_);
+                    auto& q = stripe.Rooms.find(room)->second;
+                    if (q.Tasks.empty()) {
+                        break;
+                    }
+                    task = std::move(q.Tasks.front());
+                    q.Tasks.pop_front();
+                }
+                task(); // packaged_task keeps exceptions for the future
+            }
+
+            bool more = false;
+            {
+                std::lock_guard lk(stripe.Mutex_);
+                auto it = stripe.Rooms.find(room);
+                if (it->second.Tasks.empty()) {
+                    stripe.Rooms.erase(it);
+                } else {
+                    more = true;
+                }
+            }
+            if (more) {
+                PushReady(worker, room);
+            }
+        }
+    }
+
+} // namespace NBooking
@@ -0,0 +1,193 @@
+#include <ChangeFeed.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace NBooking {
+
+    namespace {
+
+        bool InFilter(const TChangeFilter& f, const TBooking& b) {
+            if (std::find(f.Rooms.begin(), f.Rooms.end(), b.RoomIdInternal) != f.Rooms.end()) {
+                return true;
+            }
+            return std::any_of(b.Resources.begin(), b.Resources.end(), [&](const TResource& r) {
+                return std::any_of(f.Resources.begin(), f.Resources.end(), [&](const TResource& w) {
+                    return w.Id == r.Id;
+                });
+            });
+        }
+
+    } // namespace
+
+    bool TChangeFilter::Matches(const TChangeEvent& e) const {
+        if (Rooms.empty() && Resources.empty()) {
+            return true;
+        }
+        return InFilter(*this, e.Booking) || (e.Previous && InFilter(*this, *e.Previous));
+    }
+
+    TChangeFeed::TSubscription::TSubscription(TChangeFilter filter, size_t limit, uint64_t lastSeq)
+        : Filter(std::move(filter))
+        , Limit(limit)
+        , Delivered(lastSeq) {
+    }
+
+    std::vector<TChangeEventPtr> TChangeFeed::TSubscription::Poll(size_t max, std::chrono::milliseconds wait) {
+        std::unique_lock lk(Mutex_);
+        if (Queue.empty() && wait.count() > 0) {
+            Cv.wait_for(lk, wait, [&] {
+                return !Queue.empty();
+            });
+        }
+        std::vector<TChangeEventPtr> out;
+        while (!Queue.empty() && out.size() < max) {
+            out.push_back(std::move(Queue.front()));
+            Queue.pop_front();
+        }
+        if (!out.empty()) {
+            Delivered = out.back()->Seq;
+        }
+        return out;
+    }
+
+    uint64_t TChangeFeed::TSubscription::LastSeq() const {
+        std::lock_guard lk(Mutex_);
+        return Delivered;
+    }
+
+    bool TChangeFeed::TSubscription::Overflowed() const {
+        std::lock_guard lk(Mutex_);
+        return Cut;
+    }
+
+    void TChangeFeed::TSubscription::Push(const TChangeEventPtr& e) {
+        {
+            std::lock_guard lk(Mutex_);
+            if (Cut) {
+                return;
+            }
+            if (Queue.size() >= Limit) {
+                Cut = true;
+                return;
+            }
+            Queue.push_back(e);
+        }
+        Cv.notify_one();
+    }
+
+    TChangeFeed::TChangeFeed(TChangeFeedOptions options)
+        : Options(options) {
+    }
+
+    std::shared_ptr<TChangeFeed::TSubscription> TChangeFeed::Subscribe(TChangeFilter filter, std::optional<uint64_t> afterSeq) {
+        std::lock_guard lk(Mutex_);
+        uint64_t from = afterSeq.value_or(Seq);
+        if (from < Oldest || from > Seq) {
+            throw std::runtime_error("TChangeFeed: cannot resume after seq " + std::to_string(from) +
+                                     ", retained " + std::to_string(Oldest) + ".." + std::to_string(Seq));
+        }
+        auto sub = std::make_shared<TSubscription>(std::move(filter), Options.QueueLimit, from);
+        for (auto const& e : Recent) {
+            if (e->Seq > from && sub->Filter.Matches(*e)) {
+                sub->Push(e);
+            }
+        }
+        Sweep();
+        auto const& f = sub->Filter;
+        if (f.Rooms.empty() && f.Resources.empty()) {
+            Unfiltered.push_back(sub);
+        }
+        for (RoomId room : f.Rooms) {
+            ByRoom[room].push_back(sub);
+        }
+        for (auto const& r : f.Resources) {
+            ByResource[r.Id].push_back(sub);
+        }
+        return sub;
+    }
+
+    void TChangeFeed::Collect(TSubscribers& list, TTargets& out) {
+        std::erase_if(list, [&](const std::weak_ptr<TSubscription>& w) {
+            auto sub = w.lock();
+            if (!sub) {
+                return true;
+            }
+            out.push_back(std::move(sub));
+            return false;
+        });
+    }
+
+    void TChangeFeed::CollectFor(const TBooking& b, TTargets& out) {
+        if (auto it = ByRoom.find(b.RoomIdInternal); it != ByRoom.end()) {
+            Collect(it->second, out);
+        }
+        for (auto const& r : b.Resources) {
+            if (auto it = ByResource.find(r.Id); it != ByResource.end()) {
+                Collect(it->second, out);
+            }
+        }
+    }
+
+    void TChangeFeed::Sweep() {
+        auto expired = [](const std::weak_ptr<TSubscription>& w) {
+            return w.expired();
+        };
+        std::erase_if(Unfiltered, expired);
+        auto sweep = [&](auto& index) {
+            for (auto it = index.begin(); it != index.end();) {
+                std::erase_if(it->second, expired);
+                it = it->second.empty() ? index.erase(it) : std::next(it);
+            }
+        };
+        sweep(ByRoom);
+        sweep(ByResource);
+    }
+
+    // A subscriber may be listed under several keys of one event; it gets
+    // the event once.
+    void TChangeFeed::Publish(std::vector<TChangeEvent> events) {
+        std::lock_guard lk(Mutex_);
+        TTargets targets;
+        for (auto& ev : events) {
+            auto e = std::make_shared<const TChangeEvent>(std::move(ev));
+            Seq = e->Seq;
+            targets.clear();
+            Collect(Unfiltered, targets);
+            CollectFor(e->Booking, targets);
+            if (e->Previous) {
+                CollectFor(*e->Previous, targets);
+            }
+            std::sort(targets.begin(), targets.end());
+            targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+            for (auto const& sub : targets) {
+                sub->Push(e);
+            }
+            Recent.push_back(std::move(e));
+            if (Recent.size() > Options.Retain) {
+                Oldest = Recent.front()->Seq;
+                Recent.pop_front();
+            }
+        }
+    }
+
+    void TChangeFeed::Reset(uint64_t seq, uint64_t since, std::vector<TChangeEvent> replayed) {
+        std::lock_guard lk(Mutex_);
+        Recent.clear();
+        Oldest = since;
+        size_t skip = replayed.size() > Options.Retain ? replayed.size() - Options.Retain : 0;
+        if (skip > 0) {
+            Oldest = replayed[skip - 1].Seq;
+        }
+        for (size_t i = skip; i < replayed.size(); ++i) {
+            Recent.push_back(std::make_shared<const TChangeEvent>(std::move(replayed[i])));
+        }
+        Seq = seq;
+    }
+
+    uint64_t TChangeFeed::LastSeq() {
+        std::lock_guard lk(Mutex_);
+        return Seq;
+    }
+
+} // namespace NBooking
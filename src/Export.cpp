@@ -0,0 +1,90 @@
+#include <Export.hpp>
+#include <stdexcept>
+#include <string>
+
+namespace NBooking {
+
+    namespace {
+
+        constexpr char BINARY_MAGIC[4] = {'B', 'K', 'X', '1'};
+
+        // false on a clean end of stream before the first byte.
+        bool ReadVarint(std::istream& in, uint64_t& v) {
+            v = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                int c = in.get();
+                if (c == std::char_traits<char>::eof()) {
+                    if (shift == 0) {
+                        return false;
+                    }
+                    throw std::runtime_error("Binary export: truncated length");
+                }
+                v |= static_cast<uint64_t>(c & 0x7f) << shift;
+                if (!(c & 0x80)) {
+                    return true;
+                }
+            }
+            throw std::runtime_error("Binary export: varint overflow");
+        }
+
+    } // namespace
+
+    size_t ExportJson(IRepository& repo, std::ostream& out, const TExportOptions& options) {
+        out << '[';
+        bool first = true;
+        size_t n = VisitBookings(repo, [&](const TBooking& b) {
+            if (!first) {
+                out << ',';
+            }
+            first = false;
+            out << BookingToJson(b).dump();
+            return static_cast<bool>(out);
+        }, options);
+        out << ']';
+        if (!out) {
+            throw std::runtime_error("Json export: write failed");
+        }
+        return n;
+    }
+
+    size_t ExportBinary(IRepository& repo, std::ostream& out, const TExportOptions& options) {
+        out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        std::string frame;
+        std::string rec;
+        size_t n = VisitBookings(repo, [&](const TBooking& b) {
+            rec.clear();
+            EncodeBooking(b, rec);
+            frame.clear();
+            NBinary::PutVarint(frame, rec.size());
+            frame += rec;
+            out.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+            return static_cast<bool>(out);
+        }, options);
+        if (!out) {
+            throw std::runtime_error("Binary export: write failed");
+        }
+        return n;
+    }
+
+    size_t ReadBinaryExport(std::istream& in, const std::function<void(TBooking)>& f) {
+        char magic[sizeof(BINARY_MAGIC)];
+        if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), BINARY_MAGIC)) {
+            throw std::runtime_error("Binary export: bad header");
+        }
+        size_t n = 0;
+        std::string rec;
+        uint64_t len = 0;
+        while (ReadVarint(in, len)) {
+            rec.resize(len);
+            if (!in.read(rec.data(), static_cast<std::streamsize>(len))) {
+                throw std::runtime_error("Binary export: truncated record");
+            }
+            TBooking b{};
+            DecodeBooking(rec, b);
+            f(std::move(b));
+            ++n;
+        }
+        return n;
+    }
+
+} // namespace NBooking
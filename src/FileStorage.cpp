@@ -0,0 +1,648 @@
+#include <FileStorage.hpp>
+#include <Metrics.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    constexpr char SNAPSHOT_MAGIC[8] = {'B', 'K', 'S', 'N', 'A', 'P', '0', '1'};
+    constexpr const char* SNAPSHOT_FILE = "snapshot.dat";
+    constexpr const char* SEGMENT_PREFIX = "journal-";
+    constexpr char ARCHIVE_MAGIC[8] = {'B', 'K', 'A', 'R', 'C', 'H', '0', '1'};
+    constexpr const char* ARCHIVE_PREFIX = "archive-";
+    constexpr const char* ARCHIVE_SUFFIX = ".dat";
+
+    [[noreturn]] void ThrowErrno(const std::string& what) {
+        throw std::runtime_error("TFileStorage: " + what + ": " + std::strerror(errno));
+    }
+
+    void WriteAll(int fd, const void* data, size_t len) {
+        auto p = static_cast<const char*>(data);
+        while (len > 0) {
+            ssize_t n = ::write(fd, p, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ThrowErrno("write");
+            }
+            p += n;
+            len -= static_cast<size_t>(n);
+        }
+    }
+
+    void SyncDir(const std::filesystem::path& dir) {
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            ThrowErrno("open " + dir.string());
+        }
+        if (::fsync(fd) != 0) {
+            int err = errno;
+            ::close(fd);
+            errno = err;
+            ThrowErrno("fsync " + dir.string());
+        }
+        if (::close(fd) != 0) {
+            ThrowErrno("close " + dir.string());
+        }
+    }
+
+    const char* SegmentSuffix(NBooking::ECodec codec) {
+        return codec == NBooking::ECodec::Binary ? ".bin" : ".log";
+    }
+
+    std::filesystem::path SegmentPath(const std::filesystem::path& dir, uint64_t index, NBooking::ECodec codec) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s%012llu%s", SEGMENT_PREFIX, static_cast<unsigned long long>(index), SegmentSuffix(codec));
+        return dir / name;
+    }
+
+    std::optional<std::pair<uint64_t, NBooking::ECodec>> ParseSegmentName(const std::filesystem::path& p) {
+        auto name = p.filename().string();
+        std::string_view prefix = SEGMENT_PREFIX;
+        for (auto codec : {NBooking::ECodec::Json, NBooking::ECodec::Binary}) {
+            std::string_view suffix = SegmentSuffix(codec);
+            if (name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                return std::make_pair(std::stoull(name.substr(prefix.size(), name.size() - prefix.size() - suffix.size())), codec);
+            }
+        }
+        return std::nullopt;
+    }
+
+    uint64_t EntrySeq(const nlohmann::json& e) {
+        return e.contains("seq") ? e["seq"].get<uint64_t>() : 0;
+    }
+
+    std::string Frame(uint64_t seq, std::string_view record) {
+        std::string out;
+        uint32_t len = static_cast<uint32_t>(record.size());
+        out.resize(sizeof(seq) + sizeof(len));
+        std::memcpy(out.data(), &seq, sizeof(seq));
+        std::memcpy(out.data() + sizeof(seq), &len, sizeof(len));
+        out.append(record.data(), record.size());
+        return out;
+    }
+
+    // Calls f(seq, payload) for every entry of a segment; payload is a json
+    // line or a binary record depending on the codec. With tail set, an
+    // unparsable last json line or a short last binary record is taken for
+    // the torn write of a crashed append: iteration stops and the length of
+    // the good prefix is returned.
+    template <class F>
+    std::optional<size_t> ForEachEntry(const std::filesystem::path& p, NBooking::ECodec codec, F&& f, bool tail = false) {
+        std::ifstream in(p, std::ios::binary);
+        if (codec == NBooking::ECodec::Json) {
+            std::string line;
+            size_t good = 0;
+            while (std::getline(in, line)) {
+                if (!line.empty()) {
+                    uint64_t seq = 0;
+                    try {
+                        seq = EntrySeq(nlohmann::json::parse(line));
+                    } catch (const nlohmann::json::parse_error&) {
+                        if (!tail || in.peek() != std::ifstream::traits_type::eof()) {
+                            throw;
+                        }
+                        return good;
+                    }
+                    f(seq, std::string_view(line));
+                }
+                good += line.size() + 1;
+            }
+            return std::nullopt;
+        }
+        const size_t size = std::filesystem::file_size(p);
+        constexpr size_t HEADER = sizeof(uint64_t) + sizeof(uint32_t);
+        std::string payload;
+        size_t good = 0;
+        while (good < size) {
+            uint64_t seq;
+            uint32_t len;
+            // A torn header can hold any length; never read past the file.
+            if (size - good < HEADER || !in.read(reinterpret_cast<char*>(&seq), sizeof(seq)) ||
+                !in.read(reinterpret_cast<char*>(&len), sizeof(len)) || len > size - good - HEADER) {
+                return tail ? std::optional<size_t>(good) : std::nullopt;
+            }
+            payload.resize(len);
+            if (!in.read(payload.data(), len)) {
+                return tail ? std::optional<size_t>(good) : std::nullopt;
+            }
+            f(seq, std::string_view(payload));
+            good += HEADER + len;
+        }
+        return std::nullopt;
+    }
+
+    struct TMapping {
+        void* Addr = nullptr;
+        size_t Len = 0;
+
+        ~TMapping() {
+            if (Addr) {
+                ::munmap(Addr, Len);
+            }
+        }
+    };
+
+    // magic, meta length, meta json, record count, count + 1 offsets, records.
+    // Written to a temporary file and renamed into place; returns the size.
+    size_t WriteRecordFile(const std::filesystem::path& dir,
+                           const std::string& file,
+                           const char (&magic)[8],
+                           const nlohmann::json& meta,
+                           const std::vector<std::string>& records) {
+        std::string metaStr = meta.dump();
+        std::vector<uint64_t> offsets;
+        offsets.reserve(records.size() + 1);
+        uint64_t off = 0;
+        for (auto const& r : records) {
+            offsets.push_back(off);
+            off += r.size();
+        }
+        offsets.push_back(off);
+
+        auto tmp = dir / (file + ".tmp");
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            ThrowErrno("open " + tmp.string());
+        }
+        uint64_t metaLen = metaStr.size();
+        uint64_t count = records.size();
+        WriteAll(fd, magic, sizeof(magic));
+        WriteAll(fd, &metaLen, sizeof(metaLen));
+        WriteAll(fd, metaStr.data(), metaStr.size());
+        WriteAll(fd, &count, sizeof(count));
+        WriteAll(fd, offsets.data(), offsets.size() * sizeof(uint64_t));
+        for (auto const& r : records) {
+            WriteAll(fd, r.data(), r.size());
+        }
+        if (::fsync(fd) != 0) {
+            ::close(fd);
+            ThrowErrno("fsync " + tmp.string());
+        }
+        ::close(fd);
+
+        std::filesystem::rename(tmp, dir / file);
+        SyncDir(dir);
+        return sizeof(magic) + sizeof(metaLen) + metaStr.size() + sizeof(count) + offsets.size() * sizeof(uint64_t) + off;
+    }
+
+    std::optional<TSnapshotView> MapRecordFile(const std::filesystem::path& path, const char (&magic)[8]) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                return std::nullopt;
+            }
+            ThrowErrno("open " + path.string());
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            ThrowErrno("fstat " + path.string());
+        }
+
+        auto mapping = std::make_shared<TMapping>();
+        mapping->Len = static_cast<size_t>(st.st_size);
+        if (mapping->Len > 0) {
+            void* addr = ::mmap(nullptr, mapping->Len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                ThrowErrno("mmap " + path.string());
+            }
+            mapping->Addr = addr;
+        }
+        ::close(fd);
+
+        auto base = static_cast<const char*>(mapping->Addr);
+        size_t pos = 0;
+        auto need = [&](size_t n) {
+            if (mapping->Len - pos < n) {
+                throw std::runtime_error("TFileStorage: truncated file " + path.string());
+            }
+        };
+        auto readU64 = [&]() {
+            need(sizeof(uint64_t));
+            uint64_t v;
+            std::memcpy(&v, base + pos, sizeof(v));
+            pos += sizeof(v);
+            return v;
+        };
+
+        need(sizeof(magic));
+        if (std::memcmp(base, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("TFileStorage: bad magic " + path.string());
+        }
+        pos += sizeof(magic);
+
+        TSnapshotView view;
+        uint64_t metaLen = readU64();
+        need(metaLen);
+        view.Meta = nlohmann::json::parse(base + pos, base + pos + metaLen);
+        pos += metaLen;
+        if (view.Meta.contains("codec") && view.Meta["codec"] == "binary") {
+            view.Codec = NBooking::ECodec::Binary;
+        }
+
+        uint64_t count = readU64();
+        need((count + 1) * sizeof(uint64_t));
+        const char* table = base + pos;
+        pos += (count + 1) * sizeof(uint64_t);
+        const char* records = base + pos;
+        auto offsetAt = [&](uint64_t i) {
+            uint64_t v;
+            std::memcpy(&v, table + i * sizeof(uint64_t), sizeof(v));
+            return v;
+        };
+        need(offsetAt(count));
+
+        view.Records.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t b = offsetAt(i);
+            uint64_t e = offsetAt(i + 1);
+            view.Records.emplace_back(records + b, e - b);
+        }
+        view.Mapping = std::move(mapping);
+        return view;
+    }
+
+    std::string ArchiveFile(const std::string& name) {
+        return ARCHIVE_PREFIX + name + ARCHIVE_SUFFIX;
+    }
+
+} // namespace
+
+TFileStorage::TFileStorage(std::filesystem::path dir, TFileStorageOptions options)
+    : Dir(std::move(dir))
+    , Options(options) {
+    std::filesystem::create_directories(Dir);
+
+    for (auto const& de : std::filesystem::directory_iterator(Dir)) {
+        if (auto parsed = ParseSegmentName(de.path())) {
+            Sealed[parsed->first] = TSegment{de.path(), parsed->second, 0};
+        }
+    }
+    // Only the newest segment was being appended to when the process
+    // stopped, so only its last line can be torn; it is cut off.
+    for (auto& [idx, seg] : Sealed) {
+        bool newest = idx == Sealed.rbegin()->first;
+        auto torn = ForEachEntry(seg.Path, seg.Codec, [&](uint64_t seq, std::string_view) {
+            seg.LastSeq = std::max(seg.LastSeq, seq);
+        }, newest);
+        if (torn) {
+            std::filesystem::resize_file(seg.Path, *torn);
+        }
+    }
+    OpenSegment(Sealed.empty() ? 1 : Sealed.rbegin()->first + 1);
+}
+
+TFileStorage::~TFileStorage() {
+    std::unique_lock lk(Mutex_);
+    WaitIdle(lk);
+    if (ActiveFd < 0) {
+        return;
+    }
+    if (!Failed) {
+        try {
+            SyncLocked();
+        } catch (const std::exception&) {
+            // every acknowledged append was synced already
+        }
+    }
+    ::close(ActiveFd);
+}
+
+void TFileStorage::SaveState(const nlohmann::json& snapshot) {
+    nlohmann::json meta = nlohmann::json::object();
+    std::vector<std::string> records;
+    for (auto const& [key, value] : snapshot.items()) {
+        if (key == "bookings" && value.is_array()) {
+            records.reserve(value.size());
+            for (auto const& jb : value) {
+                records.push_back(jb.dump());
+            }
+        } else {
+            meta[key] = value;
+        }
+    }
+
+    WriteSnapshot(meta, records);
+}
+
+void TFileStorage::SaveRecords(const nlohmann::json& meta, const std::vector<std::string>& records) {
+    nlohmann::json m = meta;
+    m["codec"] = "binary";
+    WriteSnapshot(m, records);
+}
+
+void TFileStorage::WriteSnapshot(const nlohmann::json& meta, const std::vector<std::string>& records) {
+    size_t bytes = WriteRecordFile(Dir, SNAPSHOT_FILE, SNAPSHOT_MAGIC, meta, records);
+    NBooking::NMetrics::Add(NBooking::NMetrics::ECounter::SnapshotBytes, bytes);
+}
+
+std::optional<TSnapshotView> TFileStorage::MapState() {
+    return MapRecordFile(Dir / SNAPSHOT_FILE, SNAPSHOT_MAGIC);
+}
+
+void TFileStorage::WriteArchive(const std::string& name, const nlohmann::json& meta, const std::vector<std::string>& records) {
+    auto file = ArchiveFile(name);
+    if (std::filesystem::exists(Dir / file)) {
+        throw std::runtime_error("TFileStorage: archive " + name + " exists");
+    }
+    nlohmann::json m = meta;
+    m["codec"] = "binary";
+    WriteRecordFile(Dir, file, ARCHIVE_MAGIC, m, records);
+}
+
+std::vector<std::pair<std::string, nlohmann::json>> TFileStorage::ListArchives() {
+    std::vector<std::pair<std::string, nlohmann::json>> out;
+    for (auto const& de : std::filesystem::directory_iterator(Dir)) {
+        auto file = de.path().filename().string();
+        if (!file.starts_with(ARCHIVE_PREFIX) || !file.ends_with(ARCHIVE_SUFFIX)) {
+            continue;
+        }
+        // Only the header pages of the mapping are touched.
+        if (auto view = MapRecordFile(de.path(), ARCHIVE_MAGIC)) {
+            out.emplace_back(file.substr(std::strlen(ARCHIVE_PREFIX), file.size() - std::strlen(ARCHIVE_PREFIX) - std::strlen(ARCHIVE_SUFFIX)),
+                             std::move(view->Meta));
+        }
+    }
+    std::sort(out.begin(), out.end(), [](auto const& a, auto const& b) {
+        return a.first < b.first;
+    });
+    return out;
+}
+
+std::optional<TSnapshotView> TFileStorage::MapArchive(const std::string& name) {
+    return MapRecordFile(Dir / ArchiveFile(name), ARCHIVE_MAGIC);
+}
+
+nlohmann::json TFileStorage::LoadState() {
+    auto view = MapState();
+    if (!view) {
+        return nlohmann::json::object();
+    }
+    nlohmann::json snap = view->Meta;
+    snap.erase("codec");
+    snap["bookings"] = nlohmann::json::array();
+    for (auto rec : view->Records) {
+        if (view->Codec == NBooking::ECodec::Binary) {
+            TBooking b;
+            NBooking::DecodeBooking(rec, b);
+            snap["bookings"].push_back(NBooking::BookingToJson(b));
+        } else {
+            snap["bookings"].push_back(nlohmann::json::parse(rec));
+        }
+    }
+    return snap;
+}
+
+NBooking::ECodec TFileStorage::RecordCodec() const {
+    return Options.Codec;
+}
+
+TJournalWrite TFileStorage::AppendJournal(const nlohmann::json& entry) {
+    if (Options.Codec == NBooking::ECodec::Binary) {
+        std::string rec;
+        NBooking::EncodeJournalEntry(NBooking::JournalEntryFromJson(entry), rec);
+        return WriteEntry(EntrySeq(entry), Frame(EntrySeq(entry), rec));
+    }
+    std::string line = entry.dump();
+    line.push_back('\n');
+    return WriteEntry(EntrySeq(entry), line);
+}
+
+TJournalWrite TFileStorage::AppendJournalRecord(uint64_t seq, std::string_view record) {
+    if (Options.Codec == NBooking::ECodec::Binary) {
+        return WriteEntry(seq, Frame(seq, record));
+    }
+    std::string line = NBooking::JournalEntryToJson(NBooking::DecodeJournalEntry(record)).dump();
+    line.push_back('\n');
+    return WriteEntry(seq, line);
+}
+
+// A batch never straddles segments, so an oversized one simply overfills its own.
+TJournalWrite TFileStorage::WriteEntry(uint64_t lastSeq, const std::string& bytes) {
+    if (bytes.empty()) {
+        return {};
+    }
+    std::unique_lock lk(Mutex_);
+    CheckUsable();
+    if (ActiveBytes > 0 && ActiveBytes + bytes.size() > Options.SegmentBytes) {
+        WaitIdle(lk);
+        SealSegment();
+        OpenSegment(ActiveIndex + 1);
+    }
+    try {
+        WriteAll(ActiveFd, bytes.data(), bytes.size());
+    } catch (...) {
+        // Part of the bytes may be in the file, so nothing can follow them.
+        Failed = true;
+        throw;
+    }
+    NBooking::NMetrics::Add(NBooking::NMetrics::ECounter::JournalBytes, bytes.size());
+    ActiveBytes += bytes.size();
+    ActiveLastSeq = std::max(ActiveLastSeq, lastSeq);
+    WrittenSeq = std::max(WrittenSeq, lastSeq);
+    ++Pending;
+    return {bytes.size(), ++Written};
+}
+
+void TFileStorage::SyncJournal(uint64_t ticket) {
+    std::unique_lock lk(Mutex_);
+    AwaitSync(lk, std::min(ticket, Written));
+}
+
+TJournalWrite TFileStorage::AppendJournalBatch(const std::vector<nlohmann::json>& entries) {
+    std::string bytes;
+    uint64_t last = 0;
+    for (auto const& entry : entries) {
+        uint64_t seq = EntrySeq(entry);
+        if (Options.Codec == NBooking::ECodec::Binary) {
+            std::string rec;
+            NBooking::EncodeJournalEntry(NBooking::JournalEntryFromJson(entry), rec);
+            bytes += Frame(seq, rec);
+        } else {
+            bytes += entry.dump();
+            bytes.push_back('\n');
+        }
+        last = std::max(last, seq);
+    }
+    return WriteEntry(last, bytes);
+}
+
+TJournalWrite TFileStorage::AppendJournalRecords(const std::vector<std::pair<uint64_t, std::string>>& records) {
+    std::string bytes;
+    uint64_t last = 0;
+    for (auto const& [seq, rec] : records) {
+        if (Options.Codec == NBooking::ECodec::Binary) {
+            bytes += Frame(seq, rec);
+        } else {
+            bytes += NBooking::JournalEntryToJson(NBooking::DecodeJournalEntry(rec)).dump();
+            bytes.push_back('\n');
+        }
+        last = std::max(last, seq);
+    }
+    return WriteEntry(last, bytes);
+}
+
+std::vector<nlohmann::json> TFileStorage::LoadJournal() {
+    std::lock_guard lk(Mutex_);
+    std::vector<nlohmann::json> out;
+    auto load = [&](const std::filesystem::path& p, NBooking::ECodec codec) {
+        ForEachEntry(p, codec, [&](uint64_t, std::string_view payload) {
+            if (codec == NBooking::ECodec::Binary) {
+                out.push_back(NBooking::JournalEntryToJson(NBooking::DecodeJournalEntry(payload)));
+            } else {
+                out.push_back(nlohmann::json::parse(payload));
+            }
+        });
+    };
+    for (auto const& [idx, seg] : Sealed) {
+        load(seg.Path, seg.Codec);
+    }
+    load(SegmentPath(Dir, ActiveIndex, Options.Codec), Options.Codec);
+    return out;
+}
+
+std::vector<std::string> TFileStorage::LoadJournalRecords() {
+    std::lock_guard lk(Mutex_);
+    std::vector<std::string> out;
+    auto load = [&](const std::filesystem::path& p, NBooking::ECodec codec) {
+        ForEachEntry(p, codec, [&](uint64_t, std::string_view payload) {
+            if (codec == NBooking::ECodec::Binary) {
+                out.emplace_back(payload);
+            } else {
+                NBooking::EncodeJournalEntry(NBooking::JournalEntryFromJson(nlohmann::json::parse(payload)), out.emplace_back());
+            }
+        });
+    };
+    for (auto const& [idx, seg] : Sealed) {
+        load(seg.Path, seg.Codec);
+    }
+    load(SegmentPath(Dir, ActiveIndex, Options.Codec), Options.Codec);
+    return out;
+}
+
+void TFileStorage::TruncateJournal(uint64_t seq) {
+    std::unique_lock lk(Mutex_);
+    if (ActiveBytes > 0 && ActiveLastSeq <= seq) {
+        WaitIdle(lk);
+        SealSegment();
+        OpenSegment(ActiveIndex + 1);
+    }
+    for (auto it = Sealed.begin(); it != Sealed.end();) {
+        if (it->second.LastSeq <= seq) {
+            std::filesystem::remove(it->second.Path);
+            it = Sealed.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TFileStorage::Flush() {
+    std::unique_lock lk(Mutex_);
+    WaitIdle(lk);
+    SyncLocked();
+}
+
+uint64_t TFileStorage::DurableSeq() {
+    std::lock_guard lk(Mutex_);
+    return Durable;
+}
+
+void TFileStorage::OpenSegment(uint64_t index) {
+    auto path = SegmentPath(Dir, index, Options.Codec);
+    ActiveFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (ActiveFd < 0) {
+        ThrowErrno("open " + path.string());
+    }
+    ActiveIndex = index;
+    ActiveBytes = 0;
+    ActiveLastSeq = 0;
+    Pending = 0;
+    SyncDir(Dir);
+}
+
+void TFileStorage::SealSegment() {
+    SyncLocked();
+    ::close(ActiveFd);
+    ActiveFd = -1;
+    Sealed[ActiveIndex] = TSegment{SegmentPath(Dir, ActiveIndex, Options.Codec), Options.Codec, ActiveLastSeq};
+}
+
+void TFileStorage::SyncLocked() {
+    CheckUsable();
+    if (Pending == 0) {
+        return;
+    }
+    NBooking::NMetrics::TScope timer(NBooking::NMetrics::ETimer::Fsync);
+    if (::fdatasync(ActiveFd) != 0) {
+        Failed = true;
+        ThrowErrno("fdatasync");
+    }
+    Pending = 0;
+    Synced = Written;
+    Durable = WrittenSeq;
+    SyncCv.notify_all();
+}
+
+void TFileStorage::CheckUsable() const {
+    if (Failed) {
+        throw std::runtime_error("TFileStorage: journal failed earlier, reopen the storage to recover");
+    }
+}
+
+void TFileStorage::WaitIdle(std::unique_lock<std::mutex>& lk) {
+    while (Syncing) {
+        SyncCv.wait_for(lk, SYNC_POLL);
+    }
+}
+
+// The first waiter to find no sync in flight leads one covering every
+// append written so far; the rest wait for it, or for the next one when
+// their append landed after it started. One fdatasync thus covers every
+// append made during the previous one.
+void TFileStorage::AwaitSync(std::unique_lock<std::mutex>& lk, uint64_t ticket) {
+    while (Synced < ticket) {
+        CheckUsable();
+        if (Syncing) {
+            SyncCv.wait_for(lk, SYNC_POLL);
+            continue;
+        }
+        Syncing = true;
+        uint64_t leading = Written;
+        uint64_t covered = WrittenSeq;
+        int fd = ActiveFd;
+        Pending = 0;
+        lk.unlock();
+        int rc = 0;
+        {
+            NBooking::NMetrics::TScope timer(NBooking::NMetrics::ETimer::Fsync);
+            rc = ::fdatasync(fd);
+        }
+        int err = errno;
+        lk.lock();
+        Syncing = false;
+        if (rc != 0) {
+            // Waiters see Failed and throw too.
+            Failed = true;
+            SyncCv.notify_all();
+            errno = err;
+            ThrowErrno("fdatasync");
+        }
+        Synced = std::max(Synced, leading);
+        Durable = std::max(Durable, covered);
+        SyncCv.notify_all();
+    }
+}
@@ -0,0 +1,397 @@
+#include <LoadHarness.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace NBooking::NLoad {
+
+    namespace {
+
+        [[noreturn]] void Bad(std::string_view line, const char* what) {
+            throw std::runtime_error("Trace: " + std::string(what) + ": " + std::string(line));
+        }
+
+        int Priority(ERole r) {
+            return r == ERole::Admin ? 100 : (r == ERole::Manager ? 50 : 10);
+        }
+
+        const char* RoleName(ERole r) {
+            return r == ERole::Admin ? "Admin" : (r == ERole::Manager ? "Manager" : "User");
+        }
+
+        struct TSession {
+            TUser User{0, "guest", ERole::User, 0};
+            std::vector<BookingId> Created;
+        };
+
+        // Runs one op; returns whether it succeeded.
+        bool Execute(TBookingManager& mgr, TSession& s, const TTraceOp& op, std::chrono::system_clock::time_point base) {
+            using namespace std::chrono;
+            switch (op.Op) {
+                case EOp::Login:
+                    s.User = op.User;
+                    return true;
+                case EOp::Create: {
+                    TBooking b;
+                    b.RoomIdInternal = op.Room;
+                    b.UserIdInternal = s.User.Id;
+                    b.Start = base + hours(op.StartHours);
+                    b.End = b.Start + hours(op.Hours);
+                    b.Title = op.Title;
+                    b.Description = op.Description;
+                    b.Recurrence.type = op.Recurrence;
+                    if (op.Recurrence != TRecurrence::Type::None) {
+                        b.Recurrence.Until = b.Start + hours(24 * op.RepeatDays);
+                    }
+                    auto id = mgr.CreateBooking(b, s.User);
+                    if (id) {
+                        s.Created.push_back(*id);
+                    }
+                    return id.has_value();
+                }
+                case EOp::List: {
+                    auto now = system_clock::now();
+                    mgr.ListBookings(op.Room, now - hours(24), now + hours(24));
+                    return true;
+                }
+                case EOp::Cancel: {
+                    BookingId id = 0;
+                    if (op.CancelId) {
+                        id = *op.CancelId;
+                    } else if (!s.Created.empty()) {
+                        id = s.Created.back();
+                        s.Created.pop_back();
+                    } else {
+                        return false;
+                    }
+                    return mgr.CancelBooking(id, s.User);
+                }
+                case EOp::Undo:
+                    return mgr.Undo(s.User).has_value();
+                case EOp::Redo:
+                    return mgr.Redo(s.User).has_value();
+                case EOp::COUNT:
+                    break;
+            }
+            return false;
+        }
+
+        TOpStats Summarize(std::vector<uint64_t>& ns, size_t ok) {
+            TOpStats st;
+            st.Count = ns.size();
+            st.Ok = ok;
+            if (ns.empty()) {
+                return st;
+            }
+            auto at = [&](double q) {
+                size_t k = std::min(ns.size() - 1, static_cast<size_t>(q * static_cast<double>(ns.size())));
+                std::nth_element(ns.begin(), ns.begin() + static_cast<std::ptrdiff_t>(k), ns.end());
+                return ns[k];
+            };
+            st.P50Ns = at(0.5);
+            st.P99Ns = at(0.99);
+            st.P999Ns = at(0.999);
+            st.MaxNs = *std::max_element(ns.begin(), ns.end());
+            return st;
+        }
+
+    } // namespace
+
+    const char* Name(EOp op) {
+        switch (op) {
+            case EOp::Login:
+                return "login";
+            case EOp::Create:
+                return "create";
+            case EOp::List:
+                return "list";
+            case EOp::Cancel:
+                return "cancel";
+            case EOp::Undo:
+                return "undo";
+            case EOp::Redo:
+                return "redo";
+            case EOp::COUNT:
+                break;
+        }
+        return "?";
+    }
+
+    TTraceOp ParseLine(std::string_view line) {
+        std::istringstream iss{std::string(line)};
+        TTraceOp op;
+        std::string cmd;
+        if (!(iss >> op.Client >> cmd)) {
+            Bad(line, "expected <client> <command>");
+        }
+        if (cmd == "login") {
+            UserId id;
+            std::string role;
+            if (!(iss >> id >> op.User.Name >> role)) {
+                Bad(line, "usage: login <id> <name> <role>");
+            }
+            op.Op = EOp::Login;
+            op.User.Id = id;
+            op.User.Role = role == "Admin" ? ERole::Admin : (role == "Manager" ? ERole::Manager : ERole::User);
+            op.User.Priority = Priority(op.User.Role);
+        } else if (cmd == "create") {
+            op.Op = EOp::Create;
+            if (!(iss >> op.Room >> op.Hours >> op.Title >> op.Description)) {
+                Bad(line, "usage: create <room> <hours> <title> <description> [<start_hours> [daily|weekly <days>]]");
+            }
+            if (iss >> op.StartHours) {
+                std::string rec;
+                if (iss >> rec) {
+                    if (rec == "daily") {
+                        op.Recurrence = TRecurrence::Type::Daily;
+                    } else if (rec == "weekly") {
+                        op.Recurrence = TRecurrence::Type::Weekly;
+                    } else {
+                        Bad(line, "recurrence must be daily or weekly");
+                    }
+                    if (!(iss >> op.RepeatDays)) {
+                        Bad(line, "missing series length in days");
+                    }
+                }
+            }
+        } else if (cmd == "list") {
+            op.Op = EOp::List;
+            if (!(iss >> op.Room)) {
+                op.Room = 1; // as in the CLI
+            }
+        } else if (cmd == "cancel") {
+            op.Op = EOp::Cancel;
+            std::string id;
+            if (!(iss >> id)) {
+                Bad(line, "usage: cancel <id>|last");
+            }
+            if (id != "last") {
+                try {
+                    op.CancelId = std::stoull(id);
+                } catch (const std::exception&) {
+                    Bad(line, "bad booking id");
+                }
+            }
+        } else if (cmd == "undo") {
+            op.Op = EOp::Undo;
+        } else if (cmd == "redo") {
+            op.Op = EOp::Redo;
+        } else {
+            Bad(line, "unknown command");
+        }
+        return op;
+    }
+
+    std::string FormatLine(const TTraceOp& op) {
+        std::ostringstream out;
+        out << op.Client << ' ' << Name(op.Op);
+        switch (op.Op) {
+            case EOp::Login:
+                out << ' ' << op.User.Id << ' ' << op.User.Name << ' ' << RoleName(op.User.Role);
+                break;
+            case EOp::Create:
+                out << ' ' << op.Room << ' ' << op.Hours << ' ' << op.Title << ' ' << op.Description << ' ' << op.StartHours;
+                if (op.Recurrence != TRecurrence::Type::None) {
+                    out << (op.Recurrence == TRecurrence::Type::Daily ? " daily " : " weekly ") << op.RepeatDays;
+                }
+                break;
+            case EOp::List:
+                out << ' ' << op.Room;
+                break;
+            case EOp::Cancel:
+                if (op.CancelId) {
+                    out << ' ' << *op.CancelId;
+                } else {
+                    out << " last";
+                }
+                break;
+            default:
+                break;
+        }
+        return out.str();
+    }
+
+    std::vector<TTraceOp> ReadTrace(std::istream& in) {
+        std::vector<TTraceOp> trace;
+        std::string line;
+        while (std::getline(in, line)) {
+            auto text = std::string_view(line).substr(0, line.find('#'));
+            if (text.find_first_not_of(" \t\r") == std::string_view::npos) {
+                continue;
+            }
+            trace.push_back(ParseLine(text));
+        }
+        return trace;
+    }
+
+    void WriteTrace(std::ostream& out, const std::vector<TTraceOp>& trace) {
+        for (auto const& op : trace) {
+            out << FormatLine(op) << '\n';
+        }
+    }
+
+    TLoadProfile Profile(std::string_view name) {
+        TLoadProfile p;
+        if (name == "uniform") {
+            return p;
+        }
+        if (name == "hot-rooms") {
+            p.HotRooms = 4;
+            p.HotPercent = 80;
+            return p;
+        }
+        if (name == "recurring") {
+            p.RecurringPercent = 50;
+            return p;
+        }
+        throw std::runtime_error("Unknown load profile: " + std::string(name));
+    }
+
+    std::vector<TTraceOp> Synthesize(const TLoadProfile& p) {
+        if (p.Rooms == 0 || p.HotRooms > p.Rooms) {
+            throw std::runtime_error("Load profile: need 0 <= HotRooms <= Rooms and Rooms > 0");
+        }
+        std::mt19937_64 rng(p.Seed);
+        std::uniform_int_distribution<unsigned> pct(0, 99);
+        std::uniform_int_distribution<size_t> anyRoom(1, p.Rooms);
+        std::uniform_int_distribution<size_t> hotRoom(1, std::max<size_t>(p.HotRooms, 1));
+        std::uniform_int_distribution<int> start(0, 24 * 30);
+        std::uniform_int_distribution<int> hours(1, 2);
+        std::uniform_int_distribution<int> days(7, 60);
+        auto room = [&] {
+            return static_cast<RoomId>(p.HotRooms > 0 && pct(rng) < p.HotPercent ? hotRoom(rng) : anyRoom(rng));
+        };
+
+        std::vector<TTraceOp> trace;
+        trace.reserve(p.Clients * (p.OpsPerClient + 1));
+        for (size_t c = 0; c < p.Clients; ++c) {
+            TTraceOp op;
+            op.Client = c;
+            op.Op = EOp::Login;
+            ERole role = c % 8 == 0 ? ERole::Manager : ERole::User;
+            op.User = TUser{static_cast<UserId>(100 + c), "client" + std::to_string(c), role, Priority(role)};
+            trace.push_back(std::move(op));
+        }
+        // Clients interleave, as they would in a recorded trace.
+        for (size_t i = 0; i < p.OpsPerClient; ++i) {
+            for (size_t c = 0; c < p.Clients; ++c) {
+                TTraceOp op;
+                op.Client = c;
+                unsigned k = pct(rng);
+                if (k < p.CreatePercent) {
+                    op.Op = EOp::Create;
+                    op.Room = room();
+                    op.StartHours = start(rng);
+                    op.Hours = hours(rng);
+                    if (pct(rng) < p.RecurringPercent) {
+                        op.Recurrence = pct(rng) < 50 ? TRecurrence::Type::Daily : TRecurrence::Type::Weekly;
+                        op.RepeatDays = days(rng);
+                    }
+                } else if (k < p.CreatePercent + p.ListPercent) {
+                    op.Op = EOp::List;
+                    op.Room = room();
+                } else if (k < p.CreatePercent + p.ListPercent + p.CancelPercent) {
+                    op.Op = EOp::Cancel;
+                } else {
+                    op.Op = EOp::Undo;
+                }
+                trace.push_back(std::move(op));
+            }
+        }
+        return trace;
+    }
+
+    std::string TLoadReport::ToString() const {
+        std::string out;
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "threads=%zu ops=%zu seconds=%.3f throughput=%.0f ops/s\n",
+                      Threads, All.Count, Seconds, Throughput());
+        out += buf;
+        auto row = [&](const char* name, const TOpStats& s) {
+            std::snprintf(buf, sizeof(buf), "%-8s count=%zu ok=%zu p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus\n",
+                          name, s.Count, s.Ok, s.P50Ns / 1e3, s.P99Ns / 1e3, s.P999Ns / 1e3, s.MaxNs / 1e3);
+            out += buf;
+        };
+        for (size_t i = 0; i < OPS; ++i) {
+            if (PerOp[i].Count > 0) {
+                row(Name(static_cast<EOp>(i)), PerOp[i]);
+            }
+        }
+        row("all", All);
+        return out;
+    }
+
+    TLoadReport Replay(TBookingManager& mgr, const std::vector<TTraceOp>& trace, size_t threads) {
+        threads = std::max<size_t>(threads, 1);
+        struct TWorker {
+            std::vector<const TTraceOp*> Ops;
+            std::array<std::vector<uint64_t>, OPS> Ns;
+            std::array<size_t, OPS> Ok{};
+        };
+        std::vector<TWorker> workers(threads);
+        for (auto const& op : trace) {
+            workers[op.Client % threads].Ops.push_back(&op);
+        }
+
+        auto base = std::chrono::system_clock::now();
+        std::atomic<size_t> ready{0};
+        auto run = [&](TWorker& w) {
+            std::unordered_map<size_t, TSession> sessions;
+            ready.fetch_add(1);
+            while (ready.load() < threads) {
+                std::this_thread::yield();
+            }
+            for (const TTraceOp* op : w.Ops) {
+                auto& s = sessions[op->Client];
+                auto t0 = std::chrono::steady_clock::now();
+                bool ok = false;
+                try {
+                    ok = Execute(mgr, s, *op, base);
+                } catch (const std::exception&) {
+                    ok = false; // access denied and the like count as failures
+                }
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+                size_t k = static_cast<size_t>(op->Op);
+                w.Ns[k].push_back(static_cast<uint64_t>(ns));
+                w.Ok[k] += ok;
+            }
+        };
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; ++t) {
+            pool.emplace_back(run, std::ref(workers[t]));
+        }
+        run(workers[0]);
+        for (auto& th : pool) {
+            th.join();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - t0;
+
+        TLoadReport report;
+        report.Threads = threads;
+        report.Seconds = std::chrono::duration<double>(elapsed).count();
+        std::vector<uint64_t> all;
+        size_t allOk = 0;
+        for (size_t k = 0; k < OPS; ++k) {
+            std::vector<uint64_t> ns;
+            size_t ok = 0;
+            for (auto& w : workers) {
+                ns.insert(ns.end(), w.Ns[k].begin(), w.Ns[k].end());
+                ok += w.Ok[k];
+            }
+            all.insert(all.end(), ns.begin(), ns.end());
+            allOk += ok;
+            report.PerOp[k] = Summarize(ns, ok);
+        }
+        report.All = Summarize(all, allOk);
+        return report;
+    }
+
+} // namespace NBooking::NLoad
@@ -0,0 +1,268 @@
+#include <Metrics.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <sstream>
+#include <string_view>
+
+namespace NBooking::NMetrics {
+
+    namespace {
+
+        // Bucket b holds durations in [2^(b-1), 2^b) ns; 2^47 ns is ~39 hours.
+        constexpr size_t BUCKETS = 48;
+
+        struct alignas(64) THistogram {
+            std::atomic<uint64_t> TotalNs{0};
+            std::atomic<uint64_t> MaxNs{0};
+            std::array<std::atomic<uint64_t>, BUCKETS> Buckets{};
+
+            void Record(uint64_t ns) {
+                size_t b = std::min<size_t>(std::bit_width(ns), BUCKETS - 1);
+                Buckets[b].fetch_add(1, std::memory_order_relaxed);
+                TotalNs.fetch_add(ns, std::memory_order_relaxed);
+                uint64_t cur = MaxNs.load(std::memory_order_relaxed);
+                while (ns > cur && !MaxNs.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {
+                }
+            }
+
+            TTimerStats Stats() const {
+                TTimerStats s;
+                std::array<uint64_t, BUCKETS> counts;
+                for (size_t b = 0; b < BUCKETS; ++b) {
+                    counts[b] = Buckets[b].load(std::memory_order_relaxed);
+                    s.Count += counts[b];
+                }
+                s.TotalNs = TotalNs.load(std::memory_order_relaxed);
+                s.MaxNs = MaxNs.load(std::memory_order_relaxed);
+                s.P50Ns = std::min(Quantile(counts, s.Count, 50), s.MaxNs);
+                s.P99Ns = std::min(Quantile(counts, s.Count, 99), s.MaxNs);
+                return s;
+            }
+
+            void Reset() {
+                TotalNs = 0;
+                MaxNs = 0;
+                for (auto& b : Buckets) {
+                    b = 0;
+                }
+            }
+
+            static uint64_t Quantile(const std::array<uint64_t, BUCKETS>& counts, uint64_t total, uint64_t pct) {
+                if (total == 0) {
+                    return 0;
+                }
+                uint64_t rank = (total * pct + 99) / 100;
+                uint64_t seen = 0;
+                for (size_t b = 0; b < BUCKETS; ++b) {
+                    seen += counts[b];
+                    if (seen >= rank) {
+                        return b == 0 ? 0 : (uint64_t(1) << b) - 1;
+                    }
+                }
+                return ~uint64_t(0);
+            }
+        };
+
+        struct alignas(64) TCounter {
+            std::atomic<uint64_t> Value{0};
+        };
+
+        // A strategy claims a slot on its first rejection and only bumps the count
+        // afterwards. Slots are never freed outside Reset, so they fill in order.
+        struct alignas(64) TRejectSlot {
+            std::atomic<const char*> Name{nullptr};
+            std::atomic<uint64_t> Count{0};
+        };
+
+        constexpr size_t REJECT_SLOTS = 16;
+
+        struct TRegistry {
+            std::array<THistogram, TIMERS> Timers;
+            std::array<TCounter, COUNTERS> Counters;
+            // A hot room rejects most of its creates, so this is lock-free like the
+            // counters above.
+            std::array<TRejectSlot, REJECT_SLOTS> Rejects;
+        };
+
+        TRegistry& Registry() {
+            static TRegistry r;
+            return r;
+        }
+
+        std::string FormatNs(uint64_t ns) {
+            std::ostringstream out;
+            if (ns >= 1000000) {
+                out << ns / 1000000 << "." << (ns / 100000) % 10 << "ms";
+            } else if (ns >= 1000) {
+                out << ns / 1000 << "." << (ns / 100) % 10 << "us";
+            } else {
+                out << ns << "ns";
+            }
+            return out.str();
+        }
+
+    } // namespace
+
+    const char* Name(ETimer t) {
+        switch (t) {
+            case ETimer::Create:
+                return "create";
+            case ETimer::CreateBatch:
+                return "create_batch";
+            case ETimer::Cancel:
+                return "cancel";
+            case ETimer::List:
+                return "list";
+            case ETimer::Undo:
+                return "undo";
+            case ETimer::Redo:
+                return "redo";
+            case ETimer::LockWait:
+                return "lock_wait";
+            case ETimer::HistoryLockWait:
+                return "history_lock_wait";
+            case ETimer::Load:
+                return "load";
+            case ETimer::Instances:
+                return "instances";
+            case ETimer::Resolve:
+                return "resolve";
+            case ETimer::Persist:
+                return "persist";
+            case ETimer::Journal:
+                return "journal";
+            case ETimer::Snapshot:
+                return "snapshot";
+            case ETimer::Fsync:
+                return "fsync";
+            case ETimer::COUNT:
+                break;
+        }
+        return "?";
+    }
+
+    const char* Name(ECounter c) {
+        switch (c) {
+            case ECounter::Created:
+                return "created";
+            case ECounter::Rejected:
+                return "rejected";
+            case ECounter::Preempted:
+                return "preempted";
+            case ECounter::AutoBumped:
+                return "auto_bumped";
+            case ECounter::JournalBytes:
+                return "journal_bytes";
+            case ECounter::SnapshotBytes:
+                return "snapshot_bytes";
+            case ECounter::ListCacheHits:
+                return "list_cache_hits";
+            case ECounter::ListCacheMisses:
+                return "list_cache_misses";
+            case ECounter::VersionConflicts:
+                return "version_conflicts";
+            case ECounter::COUNT:
+                break;
+        }
+        return "?";
+    }
+
+    uint64_t TStats::Rejects(const std::string& strategy) const {
+        for (auto const& [name, n] : RejectsByStrategy) {
+            if (name == strategy) {
+                return n;
+            }
+        }
+        return 0;
+    }
+
+    std::string TStats::ToString() const {
+        std::ostringstream out;
+        for (size_t i = 0; i < TIMERS; ++i) {
+            auto const& t = Timers[i];
+            if (t.Count == 0) {
+                continue;
+            }
+            out << Name(static_cast<ETimer>(i)) << ": n=" << t.Count
+                << " avg=" << FormatNs(t.TotalNs / t.Count)
+                << " p50<=" << FormatNs(t.P50Ns)
+                << " p99<=" << FormatNs(t.P99Ns)
+                << " max=" << FormatNs(t.MaxNs) << "\n";
+        }
+        for (size_t i = 0; i < COUNTERS; ++i) {
+            if (Counters[i] != 0) {
+                out << Name(static_cast<ECounter>(i)) << ": " << Counters[i] << "\n";
+            }
+        }
+        for (auto const& [name, n] : RejectsByStrategy) {
+            out << "rejected_by_" << name << ": " << n << "\n";
+        }
+        return out.str();
+    }
+
+    TStats Snapshot() {
+        TStats s;
+        if constexpr (!ENABLED) {
+            return s;
+        }
+        auto& r = Registry();
+        for (size_t i = 0; i < TIMERS; ++i) {
+            s.Timers[i] = r.Timers[i].Stats();
+        }
+        for (size_t i = 0; i < COUNTERS; ++i) {
+            s.Counters[i] = r.Counters[i].Value.load(std::memory_order_relaxed);
+        }
+        for (auto const& slot : r.Rejects) {
+            const char* name = slot.Name.load(std::memory_order_acquire);
+            if (!name) {
+                break;
+            }
+            s.RejectsByStrategy.emplace_back(name, slot.Count.load(std::memory_order_relaxed));
+        }
+        return s;
+    }
+
+    void Reset() {
+        auto& r = Registry();
+        for (auto& t : r.Timers) {
+            t.Reset();
+        }
+        for (auto& c : r.Counters) {
+            c.Value = 0;
+        }
+        for (auto& slot : r.Rejects) {
+            slot.Count = 0;
+            slot.Name = nullptr;
+        }
+    }
+
+    namespace NDetail {
+
+        void Record(ETimer t, uint64_t ns) {
+            Registry().Timers[static_cast<size_t>(t)].Record(ns);
+        }
+
+        void Add(ECounter c, uint64_t n) {
+            Registry().Counters[static_cast<size_t>(c)].Value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        void Reject(const char* strategy) {
+            for (auto& slot : Registry().Rejects) {
+                const char* name = slot.Name.load(std::memory_order_acquire);
+                // On a lost race `name` becomes the winner's, which may be this strategy.
+                if (!name && slot.Name.compare_exchange_strong(name, strategy, std::memory_order_acq_rel)) {
+                    name = strategy;
+                }
+                if (name == strategy || std::string_view(name) == strategy) {
+                    slot.Count.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            // More strategies than slots: the rest only show in the Rejected counter.
+        }
+
+    } // namespace NDetail
+
+} // namespace NBooking::NMetrics
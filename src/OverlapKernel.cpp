@@ -0,0 +1,175 @@
+#include <OverlapKernel.hpp>
+
+#if !defined(BOOKING_NO_SIMD) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BOOKING_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace NBooking::NOverlap {
+
+    namespace {
+
+        // Scans [begin, n); vector kernels use it for their tail.
+        size_t CollectScalar(const int64_t* starts, const int64_t* ends, size_t begin, size_t n, int64_t from, int64_t to, uint32_t* out) {
+            size_t k = 0;
+            for (size_t i = begin; i < n; ++i) {
+                // branch-free: the index is stored either way, kept only on a hit
+                out[k] = static_cast<uint32_t>(i);
+                k += (starts[i] < to) & (ends[i] > from);
+            }
+            return k;
+        }
+
+        size_t FirstScalar(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to) {
+            for (size_t i = 0; i < n; ++i) {
+                if (starts[i] < to && ends[i] > from) {
+                    return i;
+                }
+            }
+            return n;
+        }
+
+#ifdef BOOKING_X86_SIMD
+        __attribute__((target("avx2"))) inline unsigned MaskAvx2(const int64_t* starts, const int64_t* ends, size_t i, __m256i from, __m256i to) {
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(starts + i));
+            __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ends + i));
+            __m256i hit = _mm256_and_si256(_mm256_cmpgt_epi64(to, s), _mm256_cmpgt_epi64(e, from));
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(hit)));
+        }
+
+        __attribute__((target("avx2"))) size_t CollectAvx2(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to, uint32_t* out) {
+            const __m256i vf = _mm256_set1_epi64x(from);
+            const __m256i vt = _mm256_set1_epi64x(to);
+            size_t k = 0;
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                for (unsigned m = MaskAvx2(starts, ends, i, vf, vt); m; m &= m - 1) {
+                    out[k++] = static_cast<uint32_t>(i + __builtin_ctz(m));
+                }
+            }
+            return k + CollectScalar(starts, ends, i, n, from, to, out + k);
+        }
+
+        __attribute__((target("avx2"))) size_t FirstAvx2(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to) {
+            const __m256i vf = _mm256_set1_epi64x(from);
+            const __m256i vt = _mm256_set1_epi64x(to);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                if (unsigned m = MaskAvx2(starts, ends, i, vf, vt)) {
+                    return i + __builtin_ctz(m);
+                }
+            }
+            return i + FirstScalar(starts + i, ends + i, n - i, from, to);
+        }
+
+        __attribute__((target("avx512f"))) inline unsigned MaskAvx512(const int64_t* starts, const int64_t* ends, size_t i, __m512i from, __m512i to) {
+            __m512i s = _mm512_loadu_si512(starts + i);
+            __m512i e = _mm512_loadu_si512(ends + i);
+            return _mm512_cmpgt_epi64_mask(to, s) & _mm512_cmpgt_epi64_mask(e, from);
+        }
+
+        __attribute__((target("avx512f"))) size_t CollectAvx512(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to, uint32_t* out) {
+            const __m512i vf = _mm512_set1_epi64(from);
+            const __m512i vt = _mm512_set1_epi64(to);
+            size_t k = 0;
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                for (unsigned m = MaskAvx512(starts, ends, i, vf, vt); m; m &= m - 1) {
+                    out[k++] = static_cast<uint32_t>(i + __builtin_ctz(m));
+                }
+            }
+            return k + CollectScalar(starts, ends, i, n, from, to, out + k);
+        }
+
+        __attribute__((target("avx512f"))) size_t FirstAvx512(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to) {
+            const __m512i vf = _mm512_set1_epi64(from);
+            const __m512i vt = _mm512_set1_epi64(to);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                if (unsigned m = MaskAvx512(starts, ends, i, vf, vt)) {
+                    return i + __builtin_ctz(m);
+                }
+            }
+            return i + FirstScalar(starts + i, ends + i, n - i, from, to);
+        }
+#endif
+
+        EKernel Detect() {
+#ifdef BOOKING_X86_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+                return EKernel::Avx512;
+            }
+            if (__builtin_cpu_supports("avx2")) {
+                return EKernel::Avx2;
+            }
+#endif
+            return EKernel::Scalar;
+        }
+
+    } // namespace
+
+    bool Supported(EKernel kernel) {
+        switch (kernel) {
+            case EKernel::Scalar:
+                return true;
+            case EKernel::Avx2:
+                return Active() != EKernel::Scalar;
+            case EKernel::Avx512:
+                return Active() == EKernel::Avx512;
+        }
+        return false;
+    }
+
+    EKernel Active() {
+        static const EKernel kernel = Detect();
+        return kernel;
+    }
+
+    const char* Name(EKernel kernel) {
+        switch (kernel) {
+            case EKernel::Scalar:
+                return "scalar";
+            case EKernel::Avx2:
+                return "avx2";
+            case EKernel::Avx512:
+                return "avx512";
+        }
+        return "unknown";
+    }
+
+    size_t Collect(EKernel kernel, const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to, uint32_t* out) {
+#ifdef BOOKING_X86_SIMD
+        if (kernel == EKernel::Avx512) {
+            return CollectAvx512(starts, ends, n, from, to, out);
+        }
+        if (kernel == EKernel::Avx2) {
+            return CollectAvx2(starts, ends, n, from, to, out);
+        }
+#endif
+        (void)kernel;
+        return CollectScalar(starts, ends, 0, n, from, to, out);
+    }
+
+    size_t First(EKernel kernel, const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to) {
+#ifdef BOOKING_X86_SIMD
+        if (kernel == EKernel::Avx512) {
+            return FirstAvx512(starts, ends, n, from, to);
+        }
+        if (kernel == EKernel::Avx2) {
+            return FirstAvx2(starts, ends, n, from, to);
+        }
+#endif
+        (void)kernel;
+        return FirstScalar(starts, ends, n, from, to);
+    }
+
+    size_t Collect(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to, uint32_t* out) {
+        return Collect(Active(), starts, ends, n, from, to, out);
+    }
+
+    size_t First(const int64_t* starts, const int64_t* ends, size_t n, int64_t from, int64_t to) {
+        return First(Active(), starts, ends, n, from, to);
+    }
+
+} // namespace NBooking::NOverlap
@@ -0,0 +1,302 @@
+#include <ShardedRepository.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace NBooking {
+
+    std::optional<size_t> TShardedRepository::TLocator::Find(BookingId id) const {
+        auto const& s = For(id);
+        std::shared_lock lk(s.Mutex_);
+        auto it = s.Shards.find(id);
+        if (it == s.Shards.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void TShardedRepository::TLocator::Set(BookingId id, size_t shard) {
+        auto& s = For(id);
+        std::unique_lock lk(s.Mutex_);
+        s.Shards[id] = static_cast<uint32_t>(shard);
+    }
+
+    void TShardedRepository::TLocator::Erase(BookingId id) {
+        auto& s = For(id);
+        std::unique_lock lk(s.Mutex_);
+        s.Shards.erase(id);
+    }
+
+    TShardedRepository::TShardedRepository(std::vector<std::shared_ptr<IRepository>> shards)
+        : Shards(std::move(shards)) {
+        if (Shards.empty()) {
+            throw std::runtime_error("TShardedRepository: no shards");
+        }
+        Index();
+    }
+
+    TShardedRepository::TShardedRepository(const std::vector<std::shared_ptr<IStorage>>& storages,
+                                           TRepositoryOptions options) {
+        if (storages.empty()) {
+            throw std::runtime_error("TShardedRepository: no shards");
+        }
+        if (options.Feed) {
+            throw std::runtime_error("TShardedRepository: options.Feed cannot be shared between shards");
+        }
+        if (!options.Ids) {
+            options.Ids = std::make_shared<TIdAllocator>();
+        }
+        Shards.reserve(storages.size());
+        for (auto const& s : storages) {
+            Shards.push_back(std::make_shared<TRepository>(s, options));
+        }
+        Index();
+    }
+
+    void TShardedRepository::Index() {
+        for (size_t i = 0; i < Shards.size(); ++i) {
+            for (auto const& b : Shards[i]->ListAll()) {
+                if (ShardOf(b.RoomIdInternal) != i) {
+                    throw std::runtime_error("TShardedRepository: booking " + std::to_string(b.Id) +
+                                             " is stored in the wrong shard");
+                }
+                Locator.Set(b.Id, i);
+            }
+        }
+    }
+
+    BookingId TShardedRepository::CreateBooking(TBooking b) {
+        size_t shard = ShardOf(b.RoomIdInternal);
+        BookingId id = Shards[shard]->CreateBooking(std::move(b));
+        Locator.Set(id, shard);
+        return id;
+    }
+
+    void TShardedRepository::UpdateBooking(TBooking b) {
+        BookingId id = b.Id;
+        size_t shard = ShardOf(b.RoomIdInternal);
+        auto old = Locator.Find(id);
+        if (!old || *old == shard) {
+            Shards[shard]->UpdateBooking(std::move(b));
+            Locator.Set(id, shard);
+            return;
+        }
+        // A failure in between leaves the booking in both shards rather
+        // than in neither; the locator already points at the new copy.
+        Shards[shard]->RestoreBooking(std::move(b));
+        Locator.Set(id, shard);
+        Shards[*old]->RemoveBooking(id);
+    }
+
+    bool TShardedRepository::UpdateBookingIf(TBooking b, uint64_t version) {
+        size_t shard = ShardOf(b.RoomIdInternal);
+        auto old = Locator.Find(b.Id);
+        if (!old) {
+            return false;
+        }
+        if (*old != shard) {
+            throw std::runtime_error("TShardedRepository: conditional update cannot move booking " + std::to_string(b.Id) +
+                                     " to another shard");
+        }
+        return Shards[shard]->UpdateBookingIf(std::move(b), version);
+    }
+
+    void TShardedRepository::RestoreBooking(TBooking b) {
+        BookingId id = b.Id;
+        size_t shard = ShardOf(b.RoomIdInternal);
+        Shards[shard]->RestoreBooking(std::move(b));
+        Locator.Set(id, shard);
+    }
+
+    void TShardedRepository::RemoveBooking(BookingId id) {
+        auto shard = Locator.Find(id);
+        if (!shard) {
+            return;
+        }
+        Shards[*shard]->RemoveBooking(id);
+        Locator.Erase(id);
+    }
+
+    std::vector<BookingId> TShardedRepository::ApplyBatch(TBookingBatch batch) {
+        // Per shard: the batch part and, for creates, their positions in the
+        // caller's batch so ids come back in the original order.
+        std::vector<TBookingBatch> parts(Shards.size());
+        std::vector<std::vector<size_t>> createdAt(Shards.size());
+        std::vector<std::vector<TBooking>> removed(Shards.size());
+        for (BookingId id : batch.Remove) {
+            auto shard = Locator.Find(id);
+            if (!shard) {
+                continue;
+            }
+            if (auto b = Shards[*shard]->GetBooking(id)) {
+                removed[*shard].push_back(std::move(*b));
+            }
+            parts[*shard].Remove.push_back(id);
+        }
+        for (auto& b : batch.Restore) {
+            parts[ShardOf(b.RoomIdInternal)].Restore.push_back(std::move(b));
+        }
+        for (size_t i = 0; i < batch.Create.size(); ++i) {
+            size_t shard = ShardOf(batch.Create[i].RoomIdInternal);
+            parts[shard].Create.push_back(std::move(batch.Create[i]));
+            createdAt[shard].push_back(i);
+        }
+
+        std::vector<BookingId> ids(batch.Create.size());
+        std::vector<size_t> applied;
+        std::vector<TBookingBatch> undo; // inverse of every applied part
+        auto revert = [&] {
+            for (size_t k = applied.size(); k-- > 0;) {
+                for (BookingId id : undo[k].Remove) {
+                    Locator.Erase(id);
+                }
+                for (auto const& b : undo[k].Restore) {
+                    Locator.Set(b.Id, applied[k]);
+                }
+                Shards[applied[k]]->ApplyBatch(std::move(undo[k]));
+            }
+        };
+        for (size_t s = 0; s < Shards.size(); ++s) {
+            auto& part = parts[s];
+            if (part.Remove.empty() && part.Restore.empty() && part.Create.empty()) {
+                continue;
+            }
+            std::vector<BookingId> removedIds = part.Remove;
+            TBookingBatch inverse;
+            inverse.Restore = std::move(removed[s]);
+            for (auto const& b : part.Restore) {
+                inverse.Remove.push_back(b.Id);
+            }
+            try {
+                auto created = Shards[s]->ApplyBatch(std::move(part));
+                for (size_t k = 0; k < created.size(); ++k) {
+                    ids[createdAt[s][k]] = created[k];
+                }
+            } catch (...) {
+                revert();
+                throw;
+            }
+            for (BookingId id : removedIds) {
+                Locator.Erase(id);
+            }
+            for (BookingId id : inverse.Remove) {
+                Locator.Set(id, s);
+            }
+            for (size_t k : createdAt[s]) {
+                Locator.Set(ids[k], s);
+                inverse.Remove.push_back(ids[k]);
+            }
+            applied.push_back(s);
+            undo.push_back(std::move(inverse));
+        }
+        return ids;
+    }
+
+    std::optional<TBooking> TShardedRepository::GetBooking(BookingId id) {
+        auto shard = Locator.Find(id);
+        if (!shard) {
+            return std::nullopt;
+        }
+        return Shards[*shard]->GetBooking(id);
+    }
+
+    std::vector<TBooking> TShardedRepository::ListAll() {
+        std::vector<TBooking> out;
+        for (auto const& s : Shards) {
+            auto part = s->ListAll();
+            out.insert(out.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+        }
+        return out;
+    }
+
+    TBookingPage TShardedRepository::ListPage(BookingId from, size_t limit) {
+        TBookingPage page;
+        std::optional<BookingId> bound;
+        for (auto const& s : Shards) {
+            auto part = s->ListPage(from, limit);
+            if (part.Next && (!bound || *part.Next < *bound)) {
+                bound = part.Next;
+            }
+            page.Items.insert(page.Items.end(), std::make_move_iterator(part.Items.begin()), std::make_move_iterator(part.Items.end()));
+        }
+        // Past the smallest Next some shard has not been read yet.
+        if (bound) {
+            std::erase_if(page.Items, [&](const TBooking& b) {
+                return b.Id >= *bound;
+            });
+        }
+        std::sort(page.Items.begin(), page.Items.end(), [](const TBooking& a, const TBooking& b) {
+            return a.Id < b.Id;
+        });
+        page.Next = bound;
+        if (page.Items.size() > limit) {
+            page.Next = page.Items[limit].Id;
+            page.Items.resize(limit);
+        }
+        return page;
+    }
+
+    std::vector<TBooking> TShardedRepository::ListInRange(RoomId room,
+                                                          std::chrono::system_clock::time_point from,
+                                                          std::chrono::system_clock::time_point to) {
+        return Shards[ShardOf(room)]->ListInRange(room, from, to);
+    }
+
+    std::vector<TBooking> TShardedRepository::ListByResources(const std::vector<TResource>& resources,
+                                                              std::chrono::system_clock::time_point from,
+                                                              std::chrono::system_clock::time_point to) {
+        std::vector<TBooking> out;
+        for (auto const& s : Shards) {
+            auto part = s->ListByResources(resources, from, to);
+            out.insert(out.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+        }
+        return out;
+    }
+
+    std::vector<TOccurrence> TShardedRepository::RoomOccurrences(RoomId room,
+                                                                 std::chrono::system_clock::time_point from,
+                                                                 std::chrono::system_clock::time_point to) {
+        return Shards[ShardOf(room)]->RoomOccurrences(room, from, to);
+    }
+
+    void TShardedRepository::AppendRoomOccurrences(RoomId room,
+                                                   std::chrono::system_clock::time_point from,
+                                                   std::chrono::system_clock::time_point to,
+                                                   std::pmr::vector<TOccurrence>& out) {
+        Shards[ShardOf(room)]->AppendRoomOccurrences(room, from, to, out);
+    }
+
+    std::vector<TOccurrence> TShardedRepository::ResourceOccurrences(const std::vector<TResource>& resources,
+                                                                     std::chrono::system_clock::time_point from,
+                                                                     std::chrono::system_clock::time_point to) {
+        std::vector<TOccurrence> out;
+        for (auto const& s : Shards) {
+            auto part = s->ResourceOccurrences(resources, from, to);
+            out.insert(out.end(), part.begin(), part.end());
+        }
+        return out;
+    }
+
+    TArchiveResult TShardedRepository::Archive(std::chrono::system_clock::time_point horizon) {
+        TArchiveResult res;
+        for (auto const& s : Shards) {
+            auto part = s->Archive(horizon);
+            for (BookingId id : part.Ids) {
+                Locator.Erase(id);
+            }
+            res.Ids.insert(res.Ids.end(), part.Ids.begin(), part.Ids.end());
+            res.Rooms.insert(res.Rooms.end(), part.Rooms.begin(), part.Rooms.end());
+            res.Segments.insert(res.Segments.end(), part.Segments.begin(), part.Segments.end());
+        }
+        std::sort(res.Rooms.begin(), res.Rooms.end());
+        res.Rooms.erase(std::unique(res.Rooms.begin(), res.Rooms.end()), res.Rooms.end());
+        return res;
+    }
+
+    std::vector<TBooking> TShardedRepository::ListArchived(RoomId room,
+                                                           std::chrono::system_clock::time_point from,
+                                                           std::chrono::system_clock::time_point to) {
+        return Shards[ShardOf(room)]->ListArchived(room, from, to);
+    }
+
+} // namespace NBooking
@@ -1,4 +1,5 @@
 #include <BookingManager.hpp>
+#include <Metrics.hpp>
 
 #include <iostream>
 #include <sstream>
@@ -23,6 +24,9 @@ int main() {
               << "  cancel <id>\n"
               << "  undo\n"
               << "  redo\n"
+              << "  archive <days>  -- move bookings finished more than <days> ago to the archive\n"
+              << "  history <room> <days>\n"
+              << "  stats\n"
               << "  exit\n";
 
     TUser current{0, "guest", ERole::User, 0};
@@ -76,7 +80,7 @@ int main() {
                 b.End = b.Start + std::chrono::hours(hours);
                 b.Title = title;
                 b.Description = desc;
-                b.Attendees = {};
+                b.Attendees.clear();
                 auto id = mgr.CreateBooking(b, current);
                 if (id) {
                     std::cout << "Created booking with id=" << *id << "\n";
@@ -97,7 +101,7 @@ int main() {
                 for (auto& b : items) {
                     auto start_s = std::chrono::duration_cast<std::chrono::seconds>(b.Start.time_since_epoch()).count();
                     auto end_s = std::chrono::duration_cast<std::chrono::seconds>(b.End.time_since_epoch()).count();
-                    std::cout << "id=" << b.Id << " title=\"" << b.Title << "\" start=" << start_s << " end=" << end_s << " owner=" << b.UserIdInternal << "\n";
+                    std::cout << "id=" << b.Id << " title=\"" << *b.Title << "\" start=" << start_s << " end=" << end_s << " owner=" << b.UserIdInternal << "\n";
                 }
                 continue;
             }
@@ -115,7 +119,7 @@ int main() {
             }
 
             if (cmd == "undo") {
-                auto res = mgr.Undo();
+                auto res = mgr.Undo(current);
                 if (res) {
                     std::cout << *res << "\n";
                 } else {
@@ -125,7 +129,7 @@ int main() {
             }
 
             if (cmd == "redo") {
-                auto res = mgr.Redo();
+                auto res = mgr.Redo(current);
                 if (res) {
                     std::cout << *res << "\n";
                 } else {
@@ -134,6 +138,44 @@ int main() {
                 continue;
             }
 
+            if (cmd == "archive") {
+                int days;
+                iss >> days;
+                if (!iss || days < 0) {
+                    std::cout << "Usage: archive <days>\n";
+                    continue;
+                }
+                auto horizon = std::chrono::system_clock::now() - std::chrono::hours(24 * days);
+                std::cout << "Archived " << mgr.Archive(horizon) << " bookings\n";
+                continue;
+            }
+
+            if (cmd == "history") {
+                RoomId rid;
+                int days;
+                iss >> rid >> days;
+                if (!iss || days < 0) {
+                    std::cout << "Usage: history <room> <days>\n";
+                    continue;
+                }
+                auto now = std::chrono::system_clock::now();
+                for (auto& b : mgr.ListHistory(rid, now - std::chrono::hours(24 * days), now)) {
+                    auto start_s = std::chrono::duration_cast<std::chrono::seconds>(b.Start.time_since_epoch()).count();
+                    auto end_s = std::chrono::duration_cast<std::chrono::seconds>(b.End.time_since_epoch()).count();
+                    std::cout << "id=" << b.Id << " title=\"" << *b.Title << "\" start=" << start_s << " end=" << end_s << " owner=" << b.UserIdInternal << "\n";
+                }
+                continue;
+            }
+
+            if (cmd == "stats") {
+                if (!NMetrics::ENABLED) {
+                    std::cout << "Metrics are disabled in this build\n";
+                    continue;
+                }
+                std::cout << NMetrics::Snapshot().ToString();
+                continue;
+            }
+
             std::cout << "Unknown command\n";
         } catch (const std::exception& ex) {
             std::cout << "Error: " << ex.what() << "\n";
@@ -0,0 +1,115 @@
+#include <BookingManager.hpp>
+#include <LoadHarness.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace NBooking;
+
+namespace {
+
+    void Usage() {
+        std::cerr << "Usage: booking_load [options]\n"
+                  << "  --trace FILE        replay a recorded trace instead of a synthetic one\n"
+                  << "  --profile NAME      uniform|hot-rooms|recurring (default uniform)\n"
+                  << "  --clients N         synthetic clients (default 16)\n"
+                  << "  --ops N             commands per synthetic client (default 1000)\n"
+                  << "  --rooms N           rooms in the synthetic trace (default 100)\n"
+                  << "  --threads N         replay threads (default 4)\n"
+                  << "  --strategy NAME     reject|preempt|auto_bump (default preempt)\n"
+                  << "  --save-trace FILE   write the trace that is replayed\n";
+    }
+
+    std::shared_ptr<IConflictStrategy> MakeStrategy(const std::string& name) {
+        if (name == "reject") {
+            return std::make_shared<TRejectStrategy>();
+        }
+        if (name == "preempt") {
+            return std::make_shared<TPreemptStrategy>();
+        }
+        if (name == "auto_bump") {
+            return std::make_shared<TAutoBumpStrategy>();
+        }
+        throw std::runtime_error("Unknown strategy: " + name);
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string tracePath;
+    std::string savePath;
+    std::string profileName = "uniform";
+    std::string strategyName = "preempt";
+    size_t threads = 4;
+    std::optional<size_t> clients, ops, rooms;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            Usage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            Usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--trace") {
+            tracePath = value;
+        } else if (arg == "--save-trace") {
+            savePath = value;
+        } else if (arg == "--profile") {
+            profileName = value;
+        } else if (arg == "--strategy") {
+            strategyName = value;
+        } else if (arg == "--threads") {
+            threads = std::stoul(value);
+        } else if (arg == "--clients") {
+            clients = std::stoul(value);
+        } else if (arg == "--ops") {
+            ops = std::stoul(value);
+        } else if (arg == "--rooms") {
+            rooms = std::stoul(value);
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+
+    try {
+        std::vector<NLoad::TTraceOp> trace;
+        if (!tracePath.empty()) {
+            std::ifstream in(tracePath);
+            if (!in) {
+                throw std::runtime_error("Cannot open trace: " + tracePath);
+            }
+            trace = NLoad::ReadTrace(in);
+        } else {
+            auto profile = NLoad::Profile(profileName);
+            profile.Clients = clients.value_or(profile.Clients);
+            profile.OpsPerClient = ops.value_or(profile.OpsPerClient);
+            profile.Rooms = rooms.value_or(profile.Rooms);
+            trace = NLoad::Synthesize(profile);
+        }
+        if (!savePath.empty()) {
+            std::ofstream out(savePath);
+            NLoad::WriteTrace(out, trace);
+        }
+
+        auto storage = std::make_shared<TMemoryStorage>();
+        auto repo = std::make_shared<TRepository>(storage);
+        TBookingManager mgr(repo, storage, MakeStrategy(strategyName));
+
+        auto report = NLoad::Replay(mgr, trace, threads);
+        std::cout << report.ToString();
+    } catch (const std::exception& e) {
+        std::cerr << "booking_load: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}